@@ -0,0 +1,117 @@
+//A very small timing harness, so the benchmarks don't need anything that isn't already here.
+// Each case is run a number of times, and its median and fastest times are reported, along with
+// the throughput, if it's given the number of bytes it works through.
+
+#ifndef ROW_BENCH_BENCH_HPP
+#define ROW_BENCH_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace row::bench {
+
+	using clock_type = std::chrono::steady_clock;
+
+	inline double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//stops the compiler throwing away work whose result isn't otherwise used
+	inline void keep(size_t x) {
+		static volatile size_t sink{ 0 };
+		sink = sink + x;
+	}
+
+	struct Result {
+		std::string name{};
+		size_t reps{ 0 };
+		double median_ms{ 0.0 };
+		double min_ms{ 0.0 };
+		double mb_per_s{ 0.0 }; //0 if the case didn't say how much it read
+	};
+
+	//command line: [--reps N] [--filter TEXT] [--csv FILE] [--scale X]
+	class Suite {
+	public:
+		Suite(int argc, char* argv[]) {
+			for (int i{ 1 }; i + 1 < argc; i += 2) {
+				const std::string_view flag{ argv[i] };
+				if (flag == "--reps") {
+					m_reps = std::max<size_t>(1, std::strtoull(argv[i + 1], nullptr, 10));
+				}
+				else if (flag == "--filter") {
+					m_filter = argv[i + 1];
+				}
+				else if (flag == "--csv") {
+					m_csv = argv[i + 1];
+				}
+				else if (flag == "--scale") {
+					m_scale = std::max(0.001, std::strtod(argv[i + 1], nullptr));
+				}
+			}
+			std::cout << std::format("{0:<44} {1:>6} {2:>12} {3:>12} {4:>10}\n", "case", "reps", "median ms", "min ms", "MB/s");
+		}
+
+		~Suite() {
+			if (m_csv.empty()) {
+				return;
+			}
+			std::ofstream out(m_csv);
+			out << "case,reps,median_ms,min_ms,mb_per_s\n";
+			for (const Result& r : m_results) {
+				out << std::format("{0},{1},{2:.4f},{3:.4f},{4:.2f}\n", r.name, r.reps, r.median_ms, r.min_ms, r.mb_per_s);
+			}
+		}
+
+		double scale() const {
+			return m_scale;
+		}
+
+		//setup is run, untimed, before each repetition, eg to undo what the last one did
+		template<typename Setup, typename F>
+		void run(const std::string& name, size_t bytes, Setup&& setup, F&& f) {
+			if (!m_filter.empty() && name.find(m_filter) == std::string::npos) {
+				return;
+			}
+			std::vector<double> times{};
+			times.reserve(m_reps);
+			for (size_t r{ 0 }; r < m_reps; ++r) {
+				setup();
+				auto start = clock_type::now();
+				f();
+				times.push_back(ms_since(start));
+			}
+			std::sort(times.begin(), times.end());
+
+			Result result{ name, m_reps, times[times.size() / 2], times.front(), 0.0 };
+			if (bytes > 0 && result.median_ms > 0.0) {
+				result.mb_per_s = static_cast<double>(bytes) / 1.0e6 / (result.median_ms / 1000.0);
+			}
+			std::cout << std::format("{0:<44} {1:>6} {2:>12.3f} {3:>12.3f} {4:>10.1f}\n", result.name, result.reps, result.median_ms, result.min_ms, result.mb_per_s);
+			m_results.push_back(std::move(result));
+		}
+
+		template<typename F>
+		void run(const std::string& name, size_t bytes, F&& f) {
+			run(name, bytes, [] {}, std::forward<F>(f));
+		}
+
+	private:
+		size_t m_reps{ 5 };
+		double m_scale{ 1.0 };
+		std::string m_filter{};
+		std::string m_csv{};
+		std::vector<Result> m_results{};
+	};
+
+}
+
+#endif
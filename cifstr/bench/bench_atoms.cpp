@@ -0,0 +1,160 @@
+//Check the element and scattering factor code tables against searching the arrays they're made from, and time
+// fixing a big _atom_site_type_symbol column and inferring atoms from a big _atom_site_label column, old and new.
+// g++ -std=c++20 -O2 -I../src -I../src/vendor bench_atoms.cpp ../src/cifstr.cpp -o bench_atoms
+
+#include <array>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cifstr.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//what fix_atom_type_i did before
+	std::string& old_fix_atom_type_i(std::string& atom) {
+		auto m = ctre::match<"([A-Za-z]{1,2})(\\d{0,}\\.?\\d{0,})([+\\-]{0,1})(\\d{0,2})">(atom);
+
+		std::string symbol{ m.get<1>().to_string() };
+		std::string charge{ m.get<2>().to_string() };
+		std::string sign{ m.get<3>().to_string() };
+		std::string digit{ m.get<4>().to_string() };
+
+		if (charge == "0") {
+			charge = "";
+			sign = "";
+		}
+		if (sign.size() == 1 && charge.empty()) {
+			if (digit.size() == 1)
+				charge = "1";
+			else
+				return atom;
+		}
+		std::string new_atom = symbol + sign + charge;
+		if (contains(allowed_atoms, new_atom)) {
+			atom = new_atom;
+			return atom;
+		}
+		logger.log(Logger::Verbosity::SOME, std::format("{0} is not a legal TOPAS scattering factor. Atom replaced with {1}.", new_atom, symbol));
+		atom = symbol;
+		return atom;
+	}
+
+	//what label_to_atom_i did before
+	std::string& old_label_to_atom_i(std::string& label) {
+		if (contains(water, label.substr(0, 3))) {
+			label = "O";
+			return label;
+		}
+		if (contains(elements, label.substr(0, 2))) {
+			label = label.substr(0, 2);
+			return label;
+		}
+		if (contains(elements, label.substr(0, 1))) {
+			label = label.substr(0, 1);
+			return label;
+		}
+		return label;
+	}
+
+	//every string of up to four characters that could be, or nearly be, an element or scattering factor
+	std::vector<std::string> make_all_short() {
+		const std::string_view alphabet{ "ABCFHNOSWZaeilnrx+-0123469." };
+		std::vector<std::string> all{ "" };
+		std::vector<std::string> level{ "" };
+		for (int len{ 1 }; len <= 4; ++len) {
+			std::vector<std::string> next{};
+			for (const std::string& s : level) {
+				for (char c : alphabet) {
+					next.push_back(s + c);
+				}
+			}
+			all.insert(all.end(), next.begin(), next.end());
+			level = std::move(next);
+		}
+		return all;
+	}
+
+	//a MOF-sized column of type symbols, written the ways CIFs write them
+	std::vector<std::string> make_types() {
+		static constexpr std::array<std::string_view, 14> types{ "Zn", "Zn2+", "O", "O2-", "C", "H", "N", "Si4+", "Al3+",
+			"Fe3+", "Cu2+", "Na+", "Cl1-", "Mn2.5+" };
+		std::vector<std::string> column{};
+		std::mt19937 gen{ 1234 };
+		std::uniform_int_distribution<size_t> pick{ 0, types.size() - 1 };
+		for (int i{ 0 }; i < 200000; ++i) {
+			column.emplace_back(types[pick(gen)]);
+		}
+		return column;
+	}
+
+	std::vector<std::string> make_labels() {
+		static constexpr std::array<std::string_view, 10> labels{ "Zn", "O", "C", "H", "N", "Si", "Al", "Cu", "Wat", "W" };
+		std::vector<std::string> column{};
+		std::mt19937 gen{ 5678 };
+		std::uniform_int_distribution<size_t> pick{ 0, labels.size() - 1 };
+		for (int i{ 0 }; i < 200000; ++i) {
+			column.push_back(std::format("{0}{1}", labels[pick(gen)], i % 97));
+		}
+		return column;
+	}
+
+	template<typename F>
+	double time_column(std::vector<std::string> column, F&& f) {
+		auto start = clock_type::now();
+		for (std::string& s : column) {
+			f(s);
+		}
+		return ms_since(start);
+	}
+
+}
+
+int main() {
+	logger.verbosity = Logger::Verbosity::NONE;
+
+	size_t mismatches{ 0 };
+	const std::vector<std::string> all{ make_all_short() };
+	for (const std::string& s : all) {
+		const bool elementOk{ is_element(s) == contains(elements, s) };
+		const bool atomOk{ is_allowed_atom(s) == contains(allowed_atoms, s) };
+
+		std::string o{ s };
+		std::string n{ s };
+		const bool fixOk{ old_fix_atom_type_i(o) == fix_atom_type_i(n) };
+		o = s;
+		n = s;
+		const bool labelOk{ old_label_to_atom_i(o) == label_to_atom_i(n) };
+
+		if (!(elementOk && atomOk && fixOk && labelOk) && ++mismatches <= 10) {
+			std::cout << std::format("mismatch: '{0}' element {1} atom {2} fix {3} label {4}\n", s, elementOk, atomOk, fixOk, labelOk);
+		}
+	}
+	std::cout << std::format("{0} strings, {1} mismatches\n", all.size(), mismatches);
+
+	const std::vector<std::string> types{ make_types() };
+	std::cout << std::format("type symbols, searching: {0:.1f} ms\n", time_column(types, [](std::string& s) { old_fix_atom_type_i(s); }));
+	std::cout << std::format("type symbols, tables:    {0:.1f} ms\n", time_column(types, [](std::string& s) { fix_atom_type_i(s); }));
+
+	std::vector<std::string_view> views{ types.begin(), types.end() };
+	auto start = clock_type::now();
+	const std::vector<std::string> fixed{ fix_atom_types(views) };
+	std::cout << std::format("type symbols, batch:     {0:.1f} ms ({1})\n", ms_since(start), fixed.size());
+
+	const std::vector<std::string> labels{ make_labels() };
+	std::cout << std::format("labels, searching: {0:.1f} ms\n", time_column(labels, [](std::string& s) { old_label_to_atom_i(s); }));
+	std::cout << std::format("labels, tables:    {0:.1f} ms\n", time_column(labels, [](std::string& s) { label_to_atom_i(s); }));
+
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+//Time building, looking things up in, and walking through Blocks with thousands of tags, like you get from
+// mmCIF files, and walking through a Cif with thousands of blocks. Exits with 1 if removing blocks while
+// walking through a Cif misses any.
+// g++ -std=c++20 -O2 -I../src/vendor bench_block.cpp -o bench_block
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "row/pdqciflib/ciffile.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//numItems single items, then numLoops loops of loopWidth tags with loopLen values each
+	row::cif::Block make_block(size_t numItems, size_t numLoops, size_t loopWidth, size_t loopLen) {
+		row::cif::Block block{};
+		for (size_t i{ 0 }; i < numItems; ++i) {
+			block.addItem(std::format("_item_{0}", i), row::cif::Datavalue{ std::to_string(i) });
+		}
+		for (size_t l{ 0 }; l < numLoops; ++l) {
+			std::vector<row::cif::dataname> tags{};
+			std::vector<row::cif::Datavalue> values{};
+			for (size_t t{ 0 }; t < loopWidth; ++t) {
+				tags.push_back(std::format("_loop_{0}.tag_{1}", l, t));
+				values.emplace_back(std::vector<std::string>(loopLen, "1.0"));
+			}
+			block.addItemsAsLoop(tags, values);
+		}
+		return block;
+	}
+
+	void run(size_t numItems, size_t numLoops, size_t loopWidth) {
+		auto start = clock_type::now();
+		row::cif::Block block{ make_block(numItems, numLoops, loopWidth, 4) };
+		double build{ ms_since(start) };
+
+		std::vector<std::string> tags{};
+		for (size_t i{ 0 }; i < numItems; ++i) {
+			tags.push_back(std::format("_ITEM_{0}", i));
+		}
+		for (size_t l{ 0 }; l < numLoops; ++l) {
+			tags.push_back(std::format("_Loop_{0}.tag_{1}", l, loopWidth - 1));
+		}
+
+		start = clock_type::now();
+		long long sum{ 0 };
+		for (int rep{ 0 }; rep < 10; ++rep) {
+			for (const std::string& tag : tags) {
+				auto [loopNum, posn] = block.getItemPosition(tag);
+				sum += loopNum + posn + block.getLoopNum(tag) + (block.isInLoop(tag) ? 1 : 0);
+			}
+		}
+		double lookup{ ms_since(start) };
+
+		start = clock_type::now();
+		for (int rep{ 0 }; rep < 10; ++rep) {
+			for (const auto& [tag, value] : block) {
+				sum += static_cast<long long>(value.size());
+			}
+		}
+		double walk{ ms_since(start) };
+
+		std::cout << std::format("{0:>6} items {1:>5} loops x {2:>2} tags: build {3:>9.2f} ms, 10x lookups {4:>9.2f} ms, 10x walks {5:>9.2f} ms  ({6})\n",
+			numItems, numLoops, loopWidth, build, lookup, walk, sum);
+	}
+
+	void run_cif(size_t numBlocks) {
+		row::cif::Cif cif{};
+		for (size_t b{ 0 }; b < numBlocks; ++b) {
+			cif.addBlock(std::format("phase_{0}", b)).addItem("_cell_length_a", row::cif::Datavalue{ "1.0" });
+		}
+
+		auto start = clock_type::now();
+		size_t sum{ 0 };
+		for (int rep{ 0 }; rep < 10; ++rep) {
+			for (const auto& [name, block] : cif) {
+				sum += block.size();
+			}
+		}
+		double walk{ ms_since(start) };
+
+		std::cout << std::format("{0:>6} blocks: 10x walks {1:>9.2f} ms  ({2})\n", numBlocks, walk, sum);
+	}
+
+	//removeBlock hands back the block after the one it removed, so blocks can be removed while walking through a Cif
+	bool check_remove_block() {
+		row::cif::Cif cif{};
+		for (const char* name : { "a", "b", "c", "d" }) {
+			cif.addBlock(name);
+		}
+		auto it = cif.removeBlock("b");
+		bool ok{ it != cif.end() && it->first == "c" && ++it != cif.end() && it->first == "d" && ++it == cif.end() };
+		ok = ok && cif.removeBlock("d") == cif.end() && cif.erase("e") == 0 && cif.erase("c") == 1;
+		cif.addBlock("c");
+		std::string seen{};
+		for (auto at = cif.begin(); at != cif.end();) {
+			seen += at->first;
+			at = cif.removeBlock(at->first);
+		}
+		ok = ok && seen == "ac" && cif.size() == 0;
+		std::cout << std::format("removing blocks while walking through a Cif: {0}\n", ok ? "ok" : "WRONG");
+		return ok;
+	}
+
+}
+
+
+int main() {
+	run(1000, 100, 10);
+	run(5000, 500, 10);
+	run(10000, 1000, 10);
+	run_cif(1000);
+	run_cif(10000);
+	return check_remove_block() ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+//Checks the event API, and shows what it saves. First, every CIF in the corpus is read as events from a string
+// with the grammar and with the lexer, from a mapped file, and from a stream through a small buffer that has to
+// be refilled many times, and all four have to make the same calls, or fail with the same error message, at the
+// same place. Then, a big powder profile is summed from a file, by reading it into a Cif, and by reading it as
+// events from a stream, with the peak memory and time of each. Exits with 1 if there's any difference.
+// bench_events [--mutations N] [--points N]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "row/pdqciflib.hpp"
+#include "cif_generator.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//what's live on the heap now, and the most there has been since reset_peak()
+	size_t live_bytes{ 0 };
+	size_t peak_bytes{ 0 };
+
+	void reset_peak() {
+		peak_bytes = live_bytes;
+	}
+
+	double mb(size_t bytes) {
+		return static_cast<double>(bytes) / 1.0e6;
+	}
+
+}
+
+//each allocation carries its size in front of it, so it can be taken off when it's freed.
+// Only the benchmark thread allocates, so the counts don't need to be atomic.
+constexpr size_t header_size{ alignof(std::max_align_t) };
+
+void* operator new(std::size_t size) {
+	if (void* p{ std::malloc(size + header_size) }) {
+		*static_cast<size_t*>(p) = size;
+		live_bytes += size;
+		peak_bytes = std::max(peak_bytes, live_bytes);
+		return static_cast<char*>(p) + header_size;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	if (p) {
+		void* start{ static_cast<char*>(p) - header_size };
+		live_bytes -= *static_cast<size_t*>(start);
+		std::free(start);
+	}
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	operator delete(p);
+}
+
+
+namespace {
+
+	namespace rc = row::cif;
+	namespace fs = std::filesystem;
+
+	//every call, written down
+	struct Transcript : rc::Events {
+		std::string s{};
+
+		void on_block(const std::string_view name) {
+			s += std::format("data_{0}\n", name);
+		}
+		void on_item(const rc::dataname_view tag, const rc::datavalue_view value) {
+			s += std::format("{0} <{1}>\n", tag, value);
+		}
+		void on_loop_header(const std::span<const rc::dataname> tags) {
+			s += "loop_";
+			for (const rc::dataname& tag : tags) {
+				s += ' ';
+				s += tag;
+			}
+			s += '\n';
+		}
+		void on_loop_value(const size_t column, const rc::datavalue_view value) {
+			s += std::format("{0}<{1}> ", column, value);
+		}
+		void on_end_loop() {
+			s += "stop_\n";
+		}
+	};
+
+	//adds up one looped column, and never keeps a value
+	struct ColumnSum : rc::Events {
+		std::string_view wanted{};
+		size_t column{ static_cast<size_t>(-1) };
+		size_t rows{ 0 };
+		double total{ 0.0 };
+
+		void on_loop_header(const std::span<const rc::dataname> tags) {
+			const auto found = std::find(tags.begin(), tags.end(), wanted);
+			column = found == tags.end() ? static_cast<size_t>(-1) : static_cast<size_t>(found - tags.begin());
+		}
+		void on_loop_value(const size_t c, const rc::datavalue_view value) {
+			if (c == column) {
+				double v{ 0.0 };
+				std::from_chars(value.data(), value.data() + value.size(), v); //up to any su
+				total += v;
+				++rows;
+			}
+		}
+		void on_end_loop() {
+			column = static_cast<size_t>(-1);
+		}
+	};
+
+	template<typename Read>
+	std::string transcribe(Read&& read) {
+		Transcript t{};
+		try {
+			read(t);
+		}
+		catch (const std::exception& e) {
+			t.s += e.what();
+		}
+		return t.s;
+	}
+
+	std::string with_crlf(const std::string& text) {
+		std::string crlf{};
+		crlf.reserve(text.size() + text.size() / 32);
+		for (const char c : text) {
+			if (c == '\n') {
+				crlf += '\r';
+			}
+			crlf += c;
+		}
+		return crlf;
+	}
+
+	//a copy of text with a few bytes changed, taken out, or put in: mostly ones that mean something to the grammar
+	std::string mutate(const std::string& text, std::mt19937& rng) {
+		static const std::vector<std::string_view> pieces{ "data_", "loop_", "save_", "stop_", "_", "#", "'", "\"", ";",
+			"\n;\n", " ", "\n", "\r", "\x01", "x" };
+		std::string s{ text };
+		const size_t changes{ 1 + rng() % 3 };
+		for (size_t i{ 0 }; i < changes && !s.empty(); ++i) {
+			const size_t at{ rng() % s.size() };
+			const std::string_view piece{ pieces[rng() % pieces.size()] };
+			switch (rng() % 3) {
+			case 0: s.erase(at, 1 + rng() % 4); break;
+			case 1: s.insert(at, piece); break;
+			default: s[at] = piece.front(); break;
+			}
+		}
+		return s;
+	}
+
+	void write_file(const fs::path& path, const std::string& text) {
+		std::ofstream file(path, std::ios::binary);
+		file.write(text.data(), static_cast<std::streamsize>(text.size()));
+	}
+
+	//reads text all four ways, and says how many of them disagree with the first
+	size_t compare(const std::string& name, const std::string& text, const fs::path& path) {
+		write_file(path, text);
+		const std::string source{ path.string() };
+		const std::vector<std::string> transcripts{
+			transcribe([&](Transcript& t) {
+				tao::pegtl::memory_input<> in(text.data(), text.size(), source);
+				rc::parse_events(in, t);
+			}),
+			transcribe([&](Transcript& t) {
+				tao::pegtl::memory_input<> in(text.data(), text.size(), source);
+				rc::parse_events(in, t, rc::Backend::Lexer);
+			}),
+			transcribe([&](Transcript& t) {
+				rc::parse_file_events(source, t);
+			}),
+			transcribe([&](Transcript& t) {
+				std::ifstream file(path, std::ios::binary);
+				rc::parse_stream_events(file, t, source, 4096);
+			}),
+		};
+		const char* const ways[]{ "string", "lexer", "mapped", "stream" };
+		size_t different{ 0 };
+		for (size_t i{ 1 }; i < transcripts.size(); ++i) {
+			if (transcripts[i] != transcripts[0]) {
+				++different;
+				std::cout << std::format("{0}: {1} differs from {2}\n--- {2}\n{3}\n--- {1}\n{4}\n", name, ways[i], ways[0],
+					transcripts[0].substr(0, 1000), transcripts[i].substr(0, 1000));
+			}
+		}
+		return different;
+	}
+
+	void sum_profile(const std::string& how, const fs::path& path, bool stream) {
+		const size_t before{ live_bytes };
+		reset_peak();
+		const auto start = clock_type::now();
+		size_t rows{ 0 };
+		double total{ 0.0 };
+		if (stream) {
+			ColumnSum sum{};
+			sum.wanted = "_pd_proc_intensity_total";
+			std::ifstream file(path, std::ios::binary);
+			rc::parse_stream_events(file, sum, path.string());
+			rows = sum.rows;
+			total = sum.total;
+		}
+		else {
+			const rc::Cif cif{ rc::read_file(path.string(), false, true) };
+			for (const auto& [name, block] : cif) {
+				if (block.contains("_pd_proc_intensity_total")) {
+					for (const auto value : block.getValue("_pd_proc_intensity_total").getViews()) {
+						double v{ 0.0 };
+						std::from_chars(value.data(), value.data() + value.size(), v);
+						total += v;
+						++rows;
+					}
+				}
+			}
+		}
+		const double time{ ms_since(start) };
+		std::cout << std::format("{0:<8} {1:>10.1f} {2:>12.2f} {3:>10} {4:>16.1f}\n", how, time, mb(peak_bytes - before), rows, total);
+	}
+
+}
+
+
+int main(int argc, char* argv[]) {
+	size_t mutations{ 500 };
+	size_t points{ 1'000'000 };
+	for (int i{ 1 }; i + 1 < argc; ++i) {
+		if (std::string_view{ argv[i] } == "--mutations") {
+			mutations = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+		else if (std::string_view{ argv[i] } == "--points") {
+			points = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+	}
+	const fs::path path{ fs::temp_directory_path() / "bench_events.cif" };
+
+	row::bench::CorpusOptions many{};
+	many.blocks = 50;
+	many.sites = 40;
+	row::bench::CorpusOptions large{};
+	large.sites = 5000;
+	large.text_fields = 3;
+	row::bench::CorpusOptions profile{};
+	profile.blocks = 2;
+	profile.profile_points = 20000;
+	const std::string manyText{ row::bench::generate_cif(many) };
+
+	size_t compared{ 4 };
+	size_t different{ 0 };
+	different += compare("many_blocks", manyText, path);
+	different += compare("many_blocks_crlf", with_crlf(manyText), path);
+	different += compare("large_structure", row::bench::generate_cif(large), path);
+	different += compare("profile", row::bench::generate_cif(profile), path);
+	std::mt19937 rng{ 2024 };
+	for (size_t i{ 0 }; i < mutations; ++i) {
+		row::bench::CorpusOptions small{};
+		small.seed = i;
+		small.blocks = 1 + i % 3;
+		small.sites = 1 + i % 12;
+		small.profile_points = i % 5 == 0 ? 20 : 0;
+		const std::string text{ row::bench::generate_cif(small) };
+		different += compare(std::format("mutated_{0}", i), mutate(i % 4 == 0 ? with_crlf(text) : text, rng), path);
+		++compared;
+	}
+	std::cout << std::format("{0} CIFs read as events four ways: {1} differences\n\n", compared, different);
+
+	row::bench::CorpusOptions big{};
+	big.sites = 20;
+	big.profile_points = points;
+	const std::string bigText{ row::bench::generate_cif(big) };
+	write_file(path, bigText);
+	std::cout << std::format("Summing _pd_proc_intensity_total over {0} points, {1:.1f} MB on disk\n", points, mb(bigText.size()));
+	std::cout << std::format("{0:<8} {1:>10} {2:>12} {3:>10} {4:>16}\n", "how", "ms", "peak MB", "rows", "total");
+	sum_profile("cif", path, false);
+	sum_profile("events", path, true);
+
+	fs::remove(path);
+	return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+//Check classify_fraction against the ctre cascade make_frac_i used to run, and time the two.
+// g++ -std=c++20 -O2 -I../src -I../src/vendor bench_frac.cpp ../src/cifstr.cpp -o bench_frac
+
+#include <array>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cifstr.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//what make_frac_i did before
+	std::string& old_frac_i(std::string& coord, const std::string_view label = "") {
+		std::string r{};
+		if (auto m1 = ctre::match<"^([+\\-]?)0?\\.16{2,}[67]$">(coord)) {
+			r = std::format("={0}1/6;", m1.get<1>().to_string());
+		}
+		else if (auto m2 = ctre::match<"^([+\\-]?)0?\\.3{4,}$">(coord)) {
+			r = std::format("={0}1/3;", m2.get<1>().to_string());
+		}
+		else if (auto m3 = ctre::match<"^([+\\-]?)0?\\.6{3,}[67]$">(coord)) {
+			r = std::format("={0}2/3;", m3.get<1>().to_string());
+		}
+		else if (auto m4 = ctre::match<"^([+\\-]?)0?\\.83{3,}$">(coord)) {
+			r = std::format("={0}5/6;", m4.get<1>().to_string());
+		}
+
+		if (!r.empty()) {
+			if (label.empty()) {
+				logger.log(Logger::Verbosity::ALL, std::format("Atomic site coordinate '{0}' replaced by '{1}'.", coord, r));
+			}
+			else {
+				logger.log(Logger::Verbosity::ALL, std::format("Atomic fractional coordinate '{0}' replaced by '{1}' for site {2}.", coord, r, label));
+			}
+			coord = r;
+		}
+		return coord;
+	}
+
+	std::vector<std::string>& old_frac_i(std::vector<std::string>& coords, const std::vector<std::string>& labels) {
+		for (size_t i{ 0 }; i < coords.size(); ++i) {
+			old_frac_i(coords[i], labels[i]);
+		}
+		return coords;
+	}
+
+	std::string old_frac(std::string coord) {
+		return old_frac_i(coord);
+	}
+
+	std::string new_frac(std::string coord) {
+		return make_frac_i(coord);
+	}
+
+	template<typename F>
+	double time_columns(const std::vector<std::string>& coords, const std::vector<std::string>& labels, F&& f) {
+		std::vector<std::vector<std::string>> columns(10, coords);
+		auto start = clock_type::now();
+		for (std::vector<std::string>& column : columns) {
+			f(column, labels);
+		}
+		return ms_since(start);
+	}
+
+	//every short string made of the characters that matter
+	std::vector<std::string> make_all_short() {
+		std::vector<std::string> coords{};
+		const std::string_view alphabet{ "+-0.136782(" };
+		std::vector<std::string> level{ "" };
+		for (int len{ 1 }; len <= 7; ++len) {
+			std::vector<std::string> next{};
+			for (const std::string& s : level) {
+				for (char c : alphabet) {
+					next.push_back(s + c);
+				}
+			}
+			coords.insert(coords.end(), next.begin(), next.end());
+			level = std::move(next);
+		}
+		return coords;
+	}
+
+	//what a big structure's coordinates look like: mostly general positions, with one in ten on a special one
+	std::vector<std::string> make_coords() {
+		static constexpr std::array<std::string_view, 10> special{ "0.16667", ".1666", "-0.33333", "+.3333", "0.66667",
+			"-.6666", "0.83333", "0.8333", "0.3333(2)", "0.25" };
+		std::vector<std::string> coords{};
+		std::mt19937 gen{ 1234 };
+		std::uniform_real_distribution<double> dist{ -1.0, 1.0 };
+		std::uniform_int_distribution<int> places{ 3, 8 };
+		std::uniform_int_distribution<size_t> pick{ 0, special.size() * 10 - 1 };
+		for (int i{ 0 }; i < 400000; ++i) {
+			const size_t k{ pick(gen) };
+			if (k < special.size()) {
+				coords.emplace_back(special[k]);
+			}
+			else {
+				coords.push_back(std::format("{0:.{1}f}", dist(gen), places(gen)));
+			}
+		}
+		return coords;
+	}
+
+}
+
+int main() {
+	logger.verbosity = Logger::Verbosity::NONE;
+
+	size_t mismatches{ 0 };
+	size_t replaced{ 0 };
+	size_t checked{ 0 };
+	for (const std::vector<std::string>& set : { make_all_short(), make_coords() }) {
+		for (const std::string& c : set) {
+			const std::string o{ old_frac(c) };
+			const std::string n{ new_frac(c) };
+			if (o != n) {
+				if (++mismatches <= 10) {
+					std::cout << std::format("mismatch: '{0}' -> regex '{1}', classifier '{2}'\n", c, o, n);
+				}
+			}
+			if (o != c) {
+				++replaced;
+			}
+			++checked;
+		}
+	}
+	std::cout << std::format("{0} coordinates, {1} replaced, {2} mismatches\n", checked, replaced, mismatches);
+
+	//the column-wise path Sites uses
+	const std::vector<std::string> coords{ make_coords() };
+	std::vector<std::string> labels{};
+	for (size_t i{ 0 }; i < coords.size(); ++i) {
+		labels.push_back(std::format("Site{0}", i));
+	}
+	std::cout << std::format("ctre cascade: {0:.1f} ms\n", time_columns(coords, labels,
+		[](std::vector<std::string>& c, const std::vector<std::string>& l) { old_frac_i(c, l); }));
+	std::cout << std::format("classifier:   {0:.1f} ms\n", time_columns(coords, labels,
+		[](std::vector<std::string>& c, const std::vector<std::string>& l) { make_frac_i(c, l); }));
+
+	//with a few more fractions switched on
+	static constexpr std::array<FractionPattern, 7> more_fractions{ {
+		special_fractions[0], special_fractions[1], special_fractions[2], special_fractions[3],
+		{ "25", '0', 0, "", "1/4" },
+		{ "125", '0', 0, "", "1/8" },
+		{ "75", '0', 0, "", "3/4" },
+	} };
+	std::cout << std::format("classifier, 7 fractions: {0:.1f} ms\n", time_columns(coords, labels,
+		[](std::vector<std::string>& c, const std::vector<std::string>& l) { make_frac_i(c, l, more_fractions); }));
+
+	return mismatches == 0 ? 0 : 1;
+}
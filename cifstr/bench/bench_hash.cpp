@@ -0,0 +1,101 @@
+//Compare the case-insensitive hash and equality used for datanames against the char-at-a-time
+// std::tolower versions they replaced.
+// g++ -std=c++20 -O2 -I../src/vendor bench_hash.cpp -o bench_hash
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "row/pdqciflib/ciffile.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	struct OldEqual {
+		using is_transparent = void;
+		bool operator()(const std::string_view left, const std::string_view right) const {
+			return left.size() == right.size() &&
+				std::equal(left.begin(), left.end(), right.begin(), [](unsigned char b, unsigned char a) { return std::tolower(a) == std::tolower(b); });
+		}
+	};
+
+	struct OldHash {
+		using is_transparent = void;
+		size_t operator()(const std::string_view key) const {
+			size_t h = 0;
+			std::for_each(key.begin(), key.end(), [&](char c) { h = h * 101 + ::tolower(c); });
+			return h;
+		}
+	};
+
+	//the sort of tags cifstr looks up, plus a few thousand mmCIF-ish ones
+	std::vector<std::string> make_tags() {
+		std::vector<std::string> tags{ "_cell_length_a", "_cell_length_b", "_cell_length_c", "_cell_angle_alpha", "_cell_angle_beta",
+			"_cell_angle_gamma", "_atom_site_label", "_atom_site_fract_x", "_atom_site_fract_y", "_atom_site_fract_z",
+			"_atom_site_occupancy", "_atom_site_type_symbol", "_atom_site_U_iso_or_equiv", "_atom_site_B_iso_or_equiv",
+			"_atom_site_aniso_label", "_atom_site_aniso_U_11", "_symmetry_space_group_name_H-M", "_space_group_name_H-M_alt",
+			"_pd_phase_name", "_chemical_name_mineral" };
+		static const std::vector<std::string> categories{ "_atom_site", "_pdbx_struct_assembly", "_struct_conn", "_entity_poly_seq", "_refine_ls_shell" };
+		for (const std::string& cat : categories) {
+			for (int i{ 0 }; i < 600; ++i) {
+				tags.push_back(std::format("{0}.Item_Number_{1}", cat, i));
+			}
+		}
+		return tags;
+	}
+
+	template<typename Hash, typename Equal>
+	void run(const std::string& name, const std::vector<std::string>& tags, const std::vector<std::string>& queries) {
+		std::unordered_map<std::string, int, Hash, Equal> map{};
+		for (size_t i{ 0 }; i < tags.size(); ++i) {
+			map.emplace(tags[i], static_cast<int>(i));
+		}
+
+		auto start = clock_type::now();
+		size_t hashes{ 0 };
+		for (int rep{ 0 }; rep < 200; ++rep) {
+			for (const std::string& q : queries) {
+				hashes += Hash{}(q);
+			}
+		}
+		double hashTime{ ms_since(start) };
+
+		start = clock_type::now();
+		long long found{ 0 };
+		for (int rep{ 0 }; rep < 200; ++rep) {
+			for (const std::string& q : queries) {
+				auto it = map.find(std::string_view{ q });
+				found += it == map.end() ? -1 : it->second;
+			}
+		}
+		double findTime{ ms_since(start) };
+
+		std::cout << std::format("{0:<12} hash {1:>8.2f} ms   find {2:>8.2f} ms   ({3} {4})\n", name, hashTime, findTime, hashes % 10, found);
+	}
+
+}
+
+
+int main() {
+	std::vector<std::string> tags{ make_tags() };
+	std::vector<std::string> queries{ tags };
+	for (std::string& q : queries) {
+		std::transform(q.begin(), q.end(), q.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+	}
+
+	run<OldHash, OldEqual>("tolower", tags, queries);
+	run<row::cif::CaseInsensitiveHash, row::cif::CaseInsensitiveEqual>("word-wise", tags, queries);
+	return 0;
+}
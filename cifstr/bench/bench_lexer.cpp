@@ -0,0 +1,200 @@
+//Checks the hand-written lexer against the PEGTL grammar, and times them both. Every CIF in the corpus is read
+// with each backend, with all the blocks and just the last, with and without a tag filter, and the two have to
+// give the same blocks, tags, values and loops, or fail with the same error message, pointing at the same place.
+// The corpus is the generated CIFs, the same with Windows line endings, a few thousand copies of them with bytes
+// changed here and there, and any CIFs given on the command line. Exits with 1 if there's any difference.
+// bench_lexer [--mutations N] [file.cif ...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "row/pdqciflib.hpp"
+#include "cif_generator.hpp"
+
+
+namespace {
+
+	namespace rc = row::cif;
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	struct Input {
+		std::string name{};
+		std::string text{};
+	};
+
+	//everything that a backend could get wrong, in a form that can be compared
+	std::string describe(const rc::Cif& cif) {
+		std::string s{};
+		for (const auto& [name, block] : cif) {
+			s += std::format("data_{0}\n", name);
+			for (const auto& tag : block.getAllTags()) {
+				s += std::format("{0} loop {1}:", tag, block.getLoopNum(tag));
+				for (const auto value : block.getValue(tag).getViews()) {
+					s += std::format(" <{0}>", value);
+				}
+				s += '\n';
+			}
+		}
+		return s;
+	}
+
+	std::string read(const Input& input, rc::Backend backend, rc::BlockSelection blocks, const rc::TagFilter* tags) {
+		rc::ParseOptions options{};
+		options.backend = backend;
+		options.blocks = blocks;
+		options.tags = tags;
+		std::ostringstream err{};
+		try {
+			return describe(rc::read_string(input.text, false, true, input.name, err, options));
+		}
+		catch (const rc::tag_value_mismatch_error&) { //its message doesn't outlive it
+			return err.str() + "tag_value_mismatch_error";
+		}
+		catch (const std::exception& e) {
+			return err.str() + e.what();
+		}
+	}
+
+	std::string with_crlf(const std::string& text) {
+		std::string crlf{};
+		crlf.reserve(text.size() + text.size() / 32);
+		for (const char c : text) {
+			if (c == '\n') {
+				crlf += '\r';
+			}
+			crlf += c;
+		}
+		return crlf;
+	}
+
+	//a copy of text with a few bytes changed, taken out, or put in: mostly ones that mean something to the grammar
+	std::string mutate(const std::string& text, std::mt19937& rng) {
+		static const std::vector<std::string_view> pieces{ "data_", "loop_", "save_", "stop_", "global_", "_", "$", "#",
+			"'", "\"", ";", "\n;", "\n;\n", " ", "\t", "\n", "\r", "\r\n", "\v", "\x01", "\xc3\xa9", "x", "1", "'a'b'" };
+		std::string s{ text };
+		const size_t changes{ 1 + rng() % 3 };
+		for (size_t i{ 0 }; i < changes && !s.empty(); ++i) {
+			const size_t at{ rng() % s.size() };
+			const std::string_view piece{ pieces[rng() % pieces.size()] };
+			switch (rng() % 3) {
+			case 0: s.erase(at, 1 + rng() % 4); break;
+			case 1: s.insert(at, piece); break;
+			default: s[at] = piece.front(); break;
+			}
+		}
+		return s;
+	}
+
+	std::vector<Input> make_corpus(size_t mutations, int argc, char* argv[]) {
+		std::vector<Input> corpus{};
+
+		row::bench::CorpusOptions many{};
+		many.blocks = 50;
+		many.sites = 40;
+		row::bench::CorpusOptions large{};
+		large.sites = 5000;
+		large.text_fields = 3;
+		row::bench::CorpusOptions profile{};
+		profile.blocks = 2;
+		profile.profile_points = 20000;
+		corpus.push_back({ "many_blocks", row::bench::generate_cif(many) });
+		corpus.push_back({ "large_structure", row::bench::generate_cif(large) });
+		corpus.push_back({ "profile", row::bench::generate_cif(profile) });
+		corpus.push_back({ "many_blocks_crlf", with_crlf(corpus[0].text) });
+
+		std::mt19937 rng{ 2024 };
+		for (size_t i{ 0 }; i < mutations; ++i) {
+			row::bench::CorpusOptions small{};
+			small.seed = i;
+			small.blocks = 1 + i % 3;
+			small.sites = 1 + i % 12;
+			small.profile_points = i % 5 == 0 ? 20 : 0;
+			const std::string text{ row::bench::generate_cif(small) };
+			corpus.push_back({ std::format("mutated_{0}", i), mutate(i % 4 == 0 ? with_crlf(text) : text, rng) });
+		}
+
+		for (int i{ 1 }; i < argc; ++i) {
+			if (std::string_view{ argv[i] } == "--mutations") {
+				++i;
+				continue;
+			}
+			std::ifstream file(argv[i], std::ios::binary);
+			corpus.push_back({ argv[i], std::string(std::istreambuf_iterator<char>(file), {}) });
+		}
+		return corpus;
+	}
+
+	//the median time, in ms, of reading text with backend
+	double time_read(const std::string& text, rc::Backend backend, size_t reps) {
+		rc::ParseOptions options{};
+		options.backend = backend;
+		std::vector<double> times{};
+		for (size_t i{ 0 }; i < reps; ++i) {
+			const auto start = clock_type::now();
+			const rc::Cif cif{ rc::read_string(text, false, false, "bench", std::cerr, options) };
+			times.push_back(ms_since(start));
+		}
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+}
+
+
+int main(int argc, char* argv[]) {
+	size_t mutations{ 2000 };
+	for (int i{ 1 }; i + 1 < argc; ++i) {
+		if (std::string_view{ argv[i] } == "--mutations") {
+			mutations = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+	}
+	const std::vector<Input> corpus{ make_corpus(mutations, argc, argv) };
+	const rc::TagFilter tags{ "_cell_length_a", "_atom_site_label", "_atom_site_fract_x", "_pd_proc_intensity_total" };
+
+	size_t compared{ 0 };
+	size_t failed{ 0 };
+	size_t different{ 0 };
+	for (const Input& input : corpus) {
+		for (const rc::BlockSelection blocks : { rc::BlockSelection::All, rc::BlockSelection::Last }) {
+			for (const rc::TagFilter* filter : { static_cast<const rc::TagFilter*>(nullptr), &tags }) {
+				const std::string pegtl{ read(input, rc::Backend::Pegtl, blocks, filter) };
+				const std::string lexer{ read(input, rc::Backend::Lexer, blocks, filter) };
+				++compared;
+				if (pegtl.ends_with("Parsing error.")) {
+					++failed;
+				}
+				if (pegtl != lexer && ++different <= 5) {
+					std::cout << std::format("{0} ({1} blocks{2}) differs\n--- pegtl\n{3}\n--- lexer\n{4}\n", input.name,
+						blocks == rc::BlockSelection::All ? "all" : "last", filter ? ", filtered" : "", pegtl.substr(0, 2000), lexer.substr(0, 2000));
+				}
+			}
+		}
+	}
+	std::cout << std::format("{0} reads of {1} CIFs compared, {2} of them parse errors: {3} differences\n\n",
+		compared, corpus.size(), failed, different);
+
+	std::cout << std::format("{0:<18} {1:>8} {2:>12} {3:>12} {4:>10}\n", "file", "MB", "pegtl MB/s", "lexer MB/s", "speedup");
+	for (size_t i{ 0 }; i < 4; ++i) {
+		const std::string& text{ corpus[i].text };
+		const double mb{ static_cast<double>(text.size()) / 1.0e6 };
+		const double pegtl{ time_read(text, rc::Backend::Pegtl, 7) };
+		const double lexer{ time_read(text, rc::Backend::Lexer, 7) };
+		std::cout << std::format("{0:<18} {1:>8.2f} {2:>12.1f} {3:>12.1f} {4:>9.2f}x\n",
+			corpus[i].name, mb, mb / (pegtl / 1000.0), mb / (lexer / 1000.0), pegtl / lexer);
+	}
+	return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+//Peak memory and time for loop-heavy files. First, putting a loop of owned strings into a Block by copying it
+// in, as the parser used to, and by moving it in, as it does now. Then, reading whole files that are mostly
+// loops: one with a big powder profile, and one with a lot of sites.
+// g++ -std=c++20 -O2 -I../src/vendor bench_loops.cpp -o bench_loops
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "row/pdqciflib.hpp"
+#include "cif_generator.hpp"
+
+
+namespace {
+
+	using clock_type = std::chrono::steady_clock;
+
+	double ms_since(clock_type::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	}
+
+	//what's live on the heap now, and the most there has been since reset_peak()
+	size_t live_bytes{ 0 };
+	size_t peak_bytes{ 0 };
+
+	void reset_peak() {
+		peak_bytes = live_bytes;
+	}
+
+	double mb(size_t bytes) {
+		return static_cast<double>(bytes) / 1.0e6;
+	}
+
+}
+
+//each allocation carries its size in front of it, so it can be taken off when it's freed.
+// Only the benchmark thread allocates, so the counts don't need to be atomic.
+constexpr size_t header_size{ alignof(std::max_align_t) };
+
+void* operator new(std::size_t size) {
+	if (void* p{ std::malloc(size + header_size) }) {
+		*static_cast<size_t*>(p) = size;
+		live_bytes += size;
+		peak_bytes = std::max(peak_bytes, live_bytes);
+		return static_cast<char*>(p) + header_size;
+	}
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+	if (p) {
+		void* start{ static_cast<char*>(p) - header_size };
+		live_bytes -= *static_cast<size_t*>(start);
+		std::free(start);
+	}
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	operator delete(p);
+}
+
+
+namespace {
+
+	namespace rc = row::cif;
+
+	//a loop as the parser has it just before it goes into the block: owned strings, one Datavalue per tag
+	void make_loop(size_t width, size_t rows, std::vector<rc::dataname>& tags, std::vector<rc::Datavalue>& values) {
+		tags.clear();
+		values.clear();
+		for (size_t t{ 0 }; t < width; ++t) {
+			tags.push_back(std::format("_pd_proc_column_{0}", t));
+			std::vector<std::string> column{};
+			column.reserve(rows);
+			for (size_t r{ 0 }; r < rows; ++r) {
+				column.push_back(std::format("{0}.{1:04}(12)", r, (r * 7919 + t) % 10000)); //too long for the small string buffer
+			}
+			values.emplace_back(std::move(column));
+		}
+	}
+
+	void insert(size_t width, size_t rows, bool move) {
+		std::vector<rc::dataname> tags{};
+		std::vector<rc::Datavalue> values{};
+		make_loop(width, rows, tags, values);
+
+		const size_t before{ live_bytes };
+		reset_peak();
+		auto start = clock_type::now();
+		rc::Block block{};
+		if (move) {
+			block.addItemsAsLoop(std::move(tags), std::move(values));
+		}
+		else {
+			block.addItemsAsLoop(tags, values);
+		}
+		values.clear(); //the buffer lets go of its values at the end of the loop
+		const double time{ ms_since(start) };
+
+		std::cout << std::format("{0:<6} {1:>6} x {2:<8} {3:>10.3f} {4:>14.2f}\n",
+			move ? "move" : "copy", width, rows, time, mb(peak_bytes - before));
+	}
+
+	void read(const std::string& name, const std::string& text, rc::ValueStorage storage) {
+		rc::ParseOptions options{};
+		options.values = storage;
+
+		const size_t before{ live_bytes };
+		reset_peak();
+		auto start = clock_type::now();
+		size_t count{ 0 };
+		{
+			rc::Cif cif{ rc::read_string(text, false, false, name, std::cerr, options) };
+			for (const auto& [blockName, block] : cif) {
+				count += block.size();
+			}
+		}
+		const double time{ ms_since(start) };
+
+		std::cout << std::format("{0:<18} {1:<6} {2:>8.2f} {3:>10.3f} {4:>14.2f} {5:>8}\n",
+			name, storage == rc::ValueStorage::Arena ? "arena" : "owned", mb(text.size()), time, mb(peak_bytes - before), count);
+	}
+
+}
+
+
+int main() {
+	std::cout << "Putting a loop into a Block\n";
+	std::cout << std::format("{0:<6} {1:>6}   {2:<8} {3:>10} {4:>14}\n", "how", "tags", "rows", "ms", "peak MB");
+	for (size_t rows : { 10'000, 100'000, 500'000 }) {
+		for (bool move : { false, true }) {
+			insert(5, rows, move);
+		}
+	}
+
+	row::bench::CorpusOptions profile{};
+	profile.sites = 20;
+	profile.profile_points = 200'000;
+	row::bench::CorpusOptions sites{};
+	sites.sites = 50'000;
+
+	const std::string profileText{ row::bench::generate_cif(profile) };
+	const std::string sitesText{ row::bench::generate_cif(sites) };
+
+	std::cout << "\nReading loop-heavy files, peak memory includes the Cif\n";
+	std::cout << std::format("{0:<18} {1:<6} {2:>8} {3:>10} {4:>14} {5:>8}\n", "file", "values", "MB", "ms", "peak MB", "tags");
+	for (rc::ValueStorage storage : { rc::ValueStorage::Owned, rc::ValueStorage::Arena }) {
+		read("profile_200k", profileText, storage);
+		read("sites_50k", sitesText, storage);
+	}
+	return 0;
+}
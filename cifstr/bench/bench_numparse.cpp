@@ -0,0 +1,203 @@
+//Checks stode_batch against stode, and times them. Every path stode_batch can take is run on the same
+// strings: the one picked for this CPU, the scalar one, and the SSSE3 one, if the CPU has it. Each value
+// and error has to have exactly the same bits as stode's. The strings are every short one made from the
+// characters that matter, a few million random ones, what a CIF's numbers look like, and copies of some of
+// them that end right at the end of a page. Exits with 1 if there's any difference.
+// bench_numparse [--reps N] [--filter TEXT] [--csv FILE]
+
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "row/pdqciflib/numparse.hpp"
+#include "bench.hpp"
+
+
+namespace {
+
+	namespace ru = row::util;
+
+	//all the strings, one after the other in one buffer, so the views point into the middle of something,
+	// as they do in a mapped file
+	struct Corpus {
+		std::string text{};
+		std::vector<std::pair<size_t, size_t>> spans{};
+
+		void add(const std::string_view s) {
+			spans.emplace_back(text.size(), s.size());
+			text += s;
+		}
+
+		std::vector<std::string_view> views() const {
+			std::vector<std::string_view> v{};
+			v.reserve(spans.size());
+			for (auto [start, len] : spans) {
+				v.emplace_back(text.data() + start, len);
+			}
+			return v;
+		}
+	};
+
+	//every string of up to 5 of these characters
+	void add_all_short(Corpus& corpus) {
+		const std::string_view alphabet{ "-+.0159()e?" };
+		std::vector<std::string> level{ "" };
+		for (int len{ 1 }; len <= 5; ++len) {
+			std::vector<std::string> next{};
+			for (const std::string& s : level) {
+				for (char c : alphabet) {
+					next.push_back(s + c);
+				}
+			}
+			for (const std::string& s : next) {
+				corpus.add(s);
+			}
+			level = std::move(next);
+		}
+	}
+
+	//mostly digits, with a sign, a point, an error and an exponent here and there, up to 24 long, so both
+	// sides of the 16 character limit are covered
+	void add_random(Corpus& corpus, const size_t count) {
+		std::mt19937 gen{ 4321 };
+		std::uniform_int_distribution<int> len{ 0, 24 };
+		std::uniform_int_distribution<int> digit{ '0', '9' };
+		std::uniform_int_distribution<int> pick{ 0, 99 };
+		const std::string_view odd{ "-+.()eE?x " };
+		std::uniform_int_distribution<size_t> oddOne{ 0, odd.size() - 1 };
+		std::string s{};
+		for (size_t i{ 0 }; i < count; ++i) {
+			s.clear();
+			const int n{ len(gen) };
+			for (int k{ 0 }; k < n; ++k) {
+				s += pick(gen) < 85 ? static_cast<char>(digit(gen)) : odd[oddOne(gen)];
+			}
+			corpus.add(s);
+		}
+	}
+
+	//what the numbers in a CIF look like: coordinates, cell lengths, occupancies, with and without errors
+	void add_cif_like(Corpus& corpus, const size_t count) {
+		std::mt19937 gen{ 1234 };
+		std::uniform_real_distribution<double> dist{ -100.0, 100.0 };
+		std::uniform_int_distribution<int> places{ 0, 9 };
+		std::uniform_int_distribution<int> err{ 0, 250 };
+		std::uniform_int_distribution<int> pick{ 0, 9 };
+		for (size_t i{ 0 }; i < count; ++i) {
+			std::string s{ std::format("{0:.{1}f}", dist(gen), places(gen)) };
+			switch (pick(gen)) {
+			case 0: s = s.substr(0, s.find('.')); break;
+			case 1: s += "(" + std::to_string(err(gen)) + ")"; break;
+			case 2: s += "(" + std::to_string(err(gen)) + ")"; break;
+			case 3: s += "e-3"; break;
+			default: break;
+			}
+			corpus.add(s);
+		}
+	}
+
+	//copies of the short views, each ending on the last byte of a page, where stode_16 can't read past the end
+	std::vector<std::string_view> at_page_ends(const std::vector<std::string_view>& views, std::unique_ptr<char[]>& memory, const size_t count) {
+		constexpr size_t page{ 4096 };
+		memory = std::make_unique<char[]>((count + 1) * page);
+		char* const first{ reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(memory.get()) + page - 1) & ~(page - 1)) };
+		std::vector<std::string_view> out{};
+		for (const std::string_view v : views) {
+			if (out.size() == count) {
+				break;
+			}
+			if (v.empty() || v.size() > 16) {
+				continue;
+			}
+			char* const end{ first + (out.size() + 1) * page };
+			std::memcpy(end - v.size(), v.data(), v.size());
+			out.emplace_back(end - v.size(), v.size());
+		}
+		return out;
+	}
+
+	//the number of values or errors that aren't what stode gives
+	size_t compare(const std::string& name, std::span<const std::string_view> in, const ru::stode_batch_fn f) {
+		std::vector<double> vals(in.size());
+		std::vector<double> errs(in.size());
+		f(in, vals.data(), errs.data());
+		size_t mismatches{ 0 };
+		for (size_t i{ 0 }; i < in.size(); ++i) {
+			auto [v, e] = ru::stode(in[i]);
+			if (std::bit_cast<uint64_t>(v) != std::bit_cast<uint64_t>(vals[i]) || std::bit_cast<uint64_t>(e) != std::bit_cast<uint64_t>(errs[i])) {
+				if (++mismatches <= 10) {
+					std::cout << std::format("{0}: '{1}' gives {2} ({3}), stode gives {4} ({5})\n", name, in[i], vals[i], errs[i], v, e);
+				}
+			}
+		}
+		return mismatches;
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	struct Path {
+		std::string name;
+		ru::stode_batch_fn f;
+	};
+	std::vector<Path> paths{ { "stode_batch", &ru::stode_batch }, { "scalar", &ru::stode_batch_scalar } };
+#ifdef ROW_NUMPARSE_X86
+	if (ru::detail::cpu_has_ssse3()) {
+		paths.push_back({ "ssse3", &ru::detail::stode_batch_ssse3 });
+	}
+	else {
+		std::cout << "no SSSE3 on this CPU, so that path isn't checked\n";
+	}
+#endif
+
+	Corpus corpus{};
+	add_all_short(corpus);
+	add_random(corpus, 3000000);
+	const size_t cifStart{ corpus.spans.size() };
+	add_cif_like(corpus, 2000000);
+	const std::vector<std::string_view> all{ corpus.views() };
+	std::unique_ptr<char[]> pages{};
+	const std::vector<std::string_view> edges{ at_page_ends(all, pages, 20000) };
+
+	size_t mismatches{ 0 };
+	for (const Path& p : paths) {
+		mismatches += compare(p.name, all, p.f);
+		mismatches += compare(p.name + " at page ends", edges, p.f);
+	}
+	std::cout << std::format("{0} strings through {1} paths: {2} mismatches\n\n", all.size() + edges.size(), paths.size(), mismatches);
+
+	//the times are for the CIF-like numbers, which is what stode_batch is for
+	row::bench::Suite suite{ argc, argv };
+	const std::span<const std::string_view> numbers{ std::span(all).subspan(cifStart) };
+	size_t bytes{ 0 };
+	for (const std::string_view v : numbers) {
+		bytes += v.size();
+	}
+	std::vector<double> vals(numbers.size());
+	std::vector<double> errs(numbers.size());
+	suite.run("stode, one at a time", bytes, [&] {
+		for (size_t i{ 0 }; i < numbers.size(); ++i) {
+			auto [v, e] = ru::stode(numbers[i]);
+			vals[i] = v;
+			errs[i] = e;
+		}
+		row::bench::keep(static_cast<size_t>(vals.back()));
+	});
+	for (const Path& p : paths) {
+		suite.run(p.name, bytes, [&] {
+			p.f(numbers, vals.data(), errs.data());
+			row::bench::keep(static_cast<size_t>(vals.back()));
+		});
+	}
+
+	return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+//Time the parts of a conversion against generated CIFs of a few shapes: parsing from a string and from a file,
+// converting values to numbers, looking tags up in and walking through Blocks, and making and writing whole
+// STRs. Made by the bench_suite target; run it with --csv FILE to keep the numbers for comparing against another build.
+// bench_suite [--reps N] [--filter TEXT] [--csv FILE] [--scale X]
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cifstr.hpp"
+#include "row/pdqciflib.hpp"
+
+#include "bench.hpp"
+#include "cif_generator.hpp"
+
+
+namespace {
+
+	namespace rc = row::cif;
+	using row::bench::Suite;
+	using row::bench::keep;
+
+	struct Corpus {
+		std::string name{};
+		row::bench::CorpusOptions options{};
+	};
+
+	size_t scaled(size_t n, double scale) {
+		return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(n) * scale));
+	}
+
+	std::vector<Corpus> make_corpora(double scale) {
+		std::vector<Corpus> corpora(3);
+
+		corpora[0].name = "many_blocks"; //a multi-phase refinement, or a database dump
+		corpora[0].options.blocks = scaled(200, scale);
+		corpora[0].options.sites = 40;
+
+		corpora[1].name = "large_structure"; //a protein-sized single block
+		corpora[1].options.sites = scaled(20000, scale);
+		corpora[1].options.text_fields = 1;
+
+		corpora[2].name = "profile"; //a powder pattern, with a long numeric loop
+		corpora[2].options.blocks = 2;
+		corpora[2].options.sites = 20;
+		corpora[2].options.profile_points = scaled(50000, scale);
+		return corpora;
+	}
+
+	size_t count_values(const rc::Cif& cif) {
+		size_t n{ 0 };
+		for (const auto& [name, block] : cif) {
+			for (const auto& tag : block.getAllTags()) {
+				n += block.getValue(tag).size();
+			}
+		}
+		return n;
+	}
+
+	void bench_parse(Suite& suite, const Corpus& corpus, const std::string& text, const std::string& path) {
+		const std::string prefix{ corpus.name + "/" };
+
+		suite.run(prefix + "read_string", text.size(), [&] {
+			keep(count_values(rc::read_string(text, false, false, corpus.name)));
+		});
+
+		rc::ParseOptions arena{};
+		arena.values = rc::ValueStorage::Arena;
+		suite.run(prefix + "read_string_arena", text.size(), [&] {
+			keep(count_values(rc::read_string(text, false, false, corpus.name, std::cerr, arena)));
+		});
+
+		//the Cif goes before the next read, so the parser reuses the same memory every time
+		rc::Parser parser{};
+		suite.run(prefix + "parser_read_string_arena", text.size(), [&] {
+			keep(count_values(parser.read_string(text, false, false, corpus.name, std::cerr, arena)));
+		});
+
+		//runs of blocks parsed at the same time; a file with only one block is read as usual
+		row::util::ThreadPool pool{};
+		rc::ParseOptions parallel{};
+		parallel.pool = &pool;
+		suite.run(prefix + "read_string_parallel", text.size(), [&] {
+			keep(count_values(rc::read_string(text, false, false, corpus.name, std::cerr, parallel)));
+		});
+
+		rc::ParseOptions lexer{};
+		lexer.backend = rc::Backend::Lexer;
+		suite.run(prefix + "read_string_lexer", text.size(), [&] {
+			keep(count_values(rc::read_string(text, false, false, corpus.name, std::cerr, lexer)));
+		});
+
+		suite.run(prefix + "read_file", text.size(), [&] {
+			keep(count_values(rc::read_file(path, false, false)));
+		});
+
+		suite.run(prefix + "read_file_mapped", text.size(), [&] {
+			keep(count_values(rc::read_file_mapped(path, false, false)));
+		});
+
+		rc::ParseOptions filtered{};
+		filtered.tags = &CrystalStructure::tag_filter();
+		suite.run(prefix + "read_file_mapped_filtered", text.size(), [&] {
+			keep(count_values(rc::read_file_mapped(path, false, false, std::cerr, filtered)));
+		});
+
+		filtered.backend = rc::Backend::Lexer;
+		suite.run(prefix + "read_mapped_filtered_lexer", text.size(), [&] {
+			keep(count_values(rc::read_file_mapped(path, false, false, std::cerr, filtered)));
+		});
+	}
+
+	void bench_values(Suite& suite, const Corpus& corpus, const rc::Cif& cif) {
+		const std::string prefix{ corpus.name + "/" };
+
+		std::vector<const rc::Datavalue*> values{};
+		for (const auto& [name, block] : cif) {
+			for (const auto& tag : block.getAllTags()) {
+				values.push_back(&block.getValue(tag));
+			}
+		}
+
+		//every value, text or not, as cifstr doesn't know which are numbers until it has looked
+		suite.run(prefix + "datavalue_convert", 0,
+			[&] {
+				for (const rc::Datavalue* v : values) {
+					v->reconvert();
+				}
+			},
+			[&] {
+				size_t n{ 0 };
+				for (const rc::Datavalue* v : values) {
+					n += v->getDoubles().size();
+				}
+				keep(n);
+			});
+	}
+
+	void bench_lookup(Suite& suite, const Corpus& corpus, const rc::Cif& cif) {
+		using namespace rc::literals;
+		const std::string prefix{ corpus.name + "/" };
+
+		//the tags as they were written, but in upper case, so none of them are found without folding case
+		std::vector<std::string> tags{};
+		for (const auto& [name, block] : cif) {
+			for (const auto& tag : block.getAllTags()) {
+				std::string upper{ tag };
+				std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+				tags.push_back(std::move(upper));
+			}
+		}
+
+		suite.run(prefix + "block_lookup_string", 0, [&] {
+			size_t n{ 0 };
+			for (const auto& [name, block] : cif) {
+				for (const std::string& tag : tags) {
+					n += block.contains(tag) ? 1 : 0;
+				}
+			}
+			keep(n);
+		});
+
+		static constexpr std::array<rc::TagKey, 8> keys{ "_cell_length_a"_tag, "_cell_length_b"_tag, "_cell_length_c"_tag,
+			"_cell_angle_beta"_tag, "_atom_site_label"_tag, "_atom_site_fract_x"_tag, "_atom_site_aniso_U_11"_tag,
+			"_symmetry_space_group_name_H-M"_tag };
+		suite.run(prefix + "block_lookup_tagkey", 0, [&] {
+			size_t n{ 0 };
+			for (size_t r{ 0 }; r < 1000; ++r) {
+				for (const auto& [name, block] : cif) {
+					for (const rc::TagKey& key : keys) {
+						n += block.contains(key) ? 1 : 0;
+					}
+				}
+			}
+			keep(n);
+		});
+	}
+
+	//walking a whole Cif, as -a does, and every item of every block, both ways
+	void bench_iterate(Suite& suite, const Corpus& corpus, const rc::Cif& cif) {
+		const std::string prefix{ corpus.name + "/" };
+
+		suite.run(prefix + "cif_iterate", 0, [&] {
+			size_t n{ 0 };
+			for (size_t r{ 0 }; r < 100; ++r) {
+				for (const auto& [name, block] : cif) {
+					n += name.size();
+				}
+			}
+			keep(n);
+		});
+
+		suite.run(prefix + "block_iterate", 0, [&] {
+			size_t n{ 0 };
+			for (const auto& [name, block] : cif) {
+				for (const auto& [tag, value] : block) {
+					n += value.size();
+				}
+			}
+			keep(n);
+		});
+
+		suite.run(prefix + "block_iterate_reverse", 0, [&] {
+			size_t n{ 0 };
+			for (const auto& [name, block] : cif) {
+				for (auto it = block.end(); --it != block.end();) {
+					n += it->second.size();
+				}
+			}
+			keep(n);
+		});
+	}
+
+	void bench_convert(Suite& suite, const Corpus& corpus, const std::string& path) {
+		const std::string prefix{ corpus.name + "/" };
+
+		rc::ParseOptions filtered{};
+		filtered.tags = &CrystalStructure::tag_filter();
+		const rc::Cif cif{ rc::read_file_mapped(path, false, false, std::cerr, filtered) };
+
+		suite.run(prefix + "crystal_structure", 0, [&] {
+			size_t n{ 0 };
+			for (const auto& [name, block] : cif) {
+				const CrystalStructure str(block, name, cif.getSource(), 0, true);
+				++n;
+			}
+			keep(n);
+		});
+
+		suite.run(prefix + "crystal_structure_write", 0, [&] {
+			std::ostringstream os{};
+			OutputSink sink{ os };
+			for (const auto& [name, block] : cif) {
+				CrystalStructure(block, name, cif.getSource(), 0, true).write_to(sink);
+			}
+			sink.flush();
+			keep(os.view().size());
+		});
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	logger.verbosity = Logger::Verbosity::NONE;
+
+	Suite suite{ argc, argv };
+	for (const Corpus& corpus : make_corpora(suite.scale())) {
+		const std::string text{ row::bench::generate_cif(corpus.options) };
+		const std::filesystem::path path{ std::filesystem::temp_directory_path() / std::format("cifstr_bench_{0}.cif", corpus.name) };
+		{
+			std::ofstream out(path, std::ios::binary);
+			out << text;
+		}
+
+		bench_parse(suite, corpus, text, path.string());
+
+		const rc::Cif cif{ rc::read_string(text, false, false, corpus.name) };
+		bench_values(suite, corpus, cif);
+		bench_lookup(suite, corpus, cif);
+		bench_iterate(suite, corpus, cif);
+		bench_convert(suite, corpus, path.string());
+
+		std::filesystem::remove(path);
+	}
+	return 0;
+}
@@ -0,0 +1,173 @@
+//Makes CIFs that look like the ones cifstr gets given, as big as you like. The same options and seed always
+// give the same text, on any platform, so timings made from them can be compared from build to build.
+
+#ifndef ROW_BENCH_CIF_GENERATOR_HPP
+#define ROW_BENCH_CIF_GENERATOR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace row::bench {
+
+	struct CorpusOptions {
+		size_t blocks{ 1 };
+		size_t sites{ 50 }; //rows in each _atom_site_ loop
+		double aniso_fraction{ 1.0 }; //how many of the sites also have a row in the _atom_site_aniso_ loop
+		size_t profile_points{ 0 }; //rows in each powder profile loop. 0 for none.
+		size_t text_fields{ 2 }; //semicolon text fields in each block
+		size_t text_lines{ 8 }; //lines in each of those
+		uint64_t seed{ 1 };
+	};
+
+	//splitmix64. The std distributions aren't the same everywhere, so they can't be used here.
+	class Random {
+	public:
+		explicit Random(uint64_t seed) : m_state{ seed } {}
+
+		uint64_t next() {
+			uint64_t z{ m_state += 0x9e3779b97f4a7c15ull };
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return z ^ (z >> 31);
+		}
+
+		//[0, n)
+		size_t below(size_t n) {
+			return static_cast<size_t>(next() % n);
+		}
+
+		//[0, 1), with 53 bits
+		double uniform() {
+			return static_cast<double>(next() >> 11) * 0x1.0p-53;
+		}
+
+	private:
+		uint64_t m_state;
+	};
+
+	namespace detail {
+
+		inline constexpr std::array<std::string_view, 12> atoms{ "O", "Si", "Al", "Na", "Ca", "Fe", "Mg", "C", "H", "N", "Zn", "Cu" };
+		inline constexpr std::array<std::string_view, 12> charges{ "2-", "4+", "3+", "+", "2+", "3+", "2+", "", "", "", "2+", "2+" };
+		inline constexpr std::array<std::string_view, 4> space_groups{ "P 1 21/c 1", "F d -3 m", "P 63/m m c", "I 41/a m d" };
+		inline constexpr std::array<std::string_view, 8> words{ "structure", "refined", "against", "powder", "diffraction", "data",
+			"collected", "synchrotron" };
+
+		//a value with a standard uncertainty, eg 0.12345(17)
+		inline void put_su(std::string& s, Random& rng, double value, int places) {
+			std::format_to(std::back_inserter(s), "{0:.{1}f}({2})", value, places, 1 + rng.below(99));
+		}
+
+		//special positions turn up often enough to be worth having
+		inline void put_coordinate(std::string& s, Random& rng) {
+			static constexpr std::array<std::string_view, 6> special{ "0", "0.5", "0.25", "0.33333", "0.66667", "-0.16667" };
+			if (rng.below(8) == 0) {
+				s += special[rng.below(special.size())];
+			}
+			else {
+				put_su(s, rng, rng.uniform(), 5);
+			}
+		}
+
+		inline void put_text_field(std::string& s, Random& rng, std::string_view tag, size_t lines) {
+			s += tag;
+			s += "\n;\n";
+			for (size_t l{ 0 }; l < lines; ++l) {
+				for (size_t w{ 0 }; w < 10; ++w) {
+					s += words[rng.below(words.size())];
+					s += ' ';
+				}
+				s += "'quoted' and \"double\" text; with punctuation.\n";
+			}
+			s += ";\n";
+		}
+
+		inline void put_block(std::string& s, Random& rng, const CorpusOptions& opt, size_t blockNum) {
+			std::format_to(std::back_inserter(s), "data_phase_{0}\n", blockNum);
+			s += "_audit_creation_method 'cif_generator'\n";
+			std::format_to(std::back_inserter(s), "_pd_phase_name 'Synthetic phase {0}'\n", blockNum);
+			std::format_to(std::back_inserter(s), "_chemical_name_mineral Mineral{0}\n", blockNum);
+			for (size_t t{ 0 }; t < opt.text_fields; ++t) {
+				put_text_field(s, rng, t == 0 ? "_publ_section_abstract" : std::format("_publ_section_comment_{0}", t), opt.text_lines);
+			}
+
+			const bool cubic{ rng.below(4) == 0 };
+			const double a{ 3.0 + 20.0 * rng.uniform() };
+			s += "_cell_length_a "; put_su(s, rng, a, 4); s += '\n';
+			s += "_cell_length_b "; put_su(s, rng, cubic ? a : 3.0 + 20.0 * rng.uniform(), 4); s += '\n';
+			s += "_cell_length_c "; put_su(s, rng, cubic ? a : 3.0 + 20.0 * rng.uniform(), 4); s += '\n';
+			s += "_cell_angle_alpha 90\n";
+			s += "_cell_angle_beta "; s += cubic ? "90" : std::format("{0:.3f}", 90.0 + 30.0 * rng.uniform()); s += '\n';
+			s += "_cell_angle_gamma 90\n";
+			std::format_to(std::back_inserter(s), "_symmetry_space_group_name_H-M '{0}'\n", space_groups[rng.below(space_groups.size())]);
+
+			s += "loop_\n_symmetry_equiv_pos_as_xyz\n'x, y, z'\n'-x, y+1/2, -z+1/2'\n'-x, -y, -z'\n'x, -y+1/2, z+1/2'\n";
+
+			//there's always at least one site, or it wouldn't be a structure
+			s += "loop_\n_atom_site_label\n_atom_site_type_symbol\n_atom_site_fract_x\n_atom_site_fract_y\n_atom_site_fract_z\n"
+				"_atom_site_U_iso_or_equiv\n_atom_site_occupancy\n_atom_site_adp_type\n";
+			std::vector<size_t> siteAtoms(std::max<size_t>(opt.sites, 1));
+			for (size_t i{ 0 }; i < siteAtoms.size(); ++i) {
+				const size_t atom{ rng.below(atoms.size()) };
+				siteAtoms[i] = atom;
+				std::format_to(std::back_inserter(s), "{0}{1} {0}{2} ", atoms[atom], i + 1, charges[atom]);
+				put_coordinate(s, rng); s += ' ';
+				put_coordinate(s, rng); s += ' ';
+				put_coordinate(s, rng); s += ' ';
+				put_su(s, rng, 0.005 + 0.03 * rng.uniform(), 4); s += ' ';
+				s += rng.below(10) == 0 ? "0.5" : "1";
+				s += " Uani\n";
+			}
+
+			//an empty loop isn't allowed, so the rows are only put in if there are some
+			std::string aniso{};
+			for (size_t i{ 0 }; i < siteAtoms.size(); ++i) {
+				if (rng.uniform() >= opt.aniso_fraction) {
+					continue;
+				}
+				std::format_to(std::back_inserter(aniso), "{0}{1}", atoms[siteAtoms[i]], i + 1);
+				for (int u{ 0 }; u < 6; ++u) {
+					aniso += ' ';
+					put_su(aniso, rng, u < 3 ? 0.005 + 0.03 * rng.uniform() : 0.004 * (rng.uniform() - 0.5), 5);
+				}
+				aniso += '\n';
+			}
+			if (!aniso.empty()) {
+				s += "loop_\n_atom_site_aniso_label\n_atom_site_aniso_U_11\n_atom_site_aniso_U_22\n_atom_site_aniso_U_33\n"
+					"_atom_site_aniso_U_12\n_atom_site_aniso_U_13\n_atom_site_aniso_U_23\n";
+				s += aniso;
+			}
+
+			if (opt.profile_points > 0) {
+				s += "loop_\n_pd_proc_point_id\n_pd_proc_2theta_corrected\n_pd_proc_intensity_total\n_pd_calc_intensity_total\n_pd_proc_ls_weight\n";
+				for (size_t i{ 0 }; i < opt.profile_points; ++i) {
+					const double tth{ 5.0 + 0.01 * static_cast<double>(i) };
+					const double obs{ 100.0 + 5000.0 * rng.uniform() * rng.uniform() };
+					std::format_to(std::back_inserter(s), "{0} {1:.4f} {2:.1f}({3}) {4:.2f} {5:.6f}\n", i + 1, tth, obs,
+						static_cast<int>(1 + obs / 100.0), obs * (0.95 + 0.1 * rng.uniform()), 1.0 / obs);
+				}
+			}
+			s += '\n';
+		}
+
+	}
+
+	inline std::string generate_cif(const CorpusOptions& opt) {
+		Random rng{ opt.seed };
+		std::string s{ "#\\#CIF_1.1\n# made by cif_generator\n\n" };
+		for (size_t b{ 0 }; b < opt.blocks; ++b) {
+			detail::put_block(s, rng, opt, b + 1);
+		}
+		return s;
+	}
+
+}
+
+#endif
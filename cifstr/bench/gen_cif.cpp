@@ -0,0 +1,47 @@
+//Write a synthetic CIF to a file, eg for timing cifstr itself:
+// gen_cif big.cif --blocks 20 --sites 5000 --profile 20000
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "argparse/argparse.hpp"
+
+#include "cif_generator.hpp"
+
+
+struct GenArgs : public argparse::Args {
+    std::string& dst_path = arg("output_file", "Where to write the CIF. It will be overwritten if it already exists.");
+    size_t& blocks = kwarg("b,blocks", "Number of data blocks.").set_default(1);
+    size_t& sites = kwarg("n,sites", "Rows in each _atom_site_ loop.").set_default(50);
+    double& aniso = kwarg("a,aniso", "Fraction of the sites that have anisotropic ADPs, 0 to 1.").set_default(1.0);
+    size_t& profile = kwarg("p,profile", "Rows in each powder profile loop. 0 for none.").set_default(0);
+    size_t& text_fields = kwarg("t,text", "Semicolon text fields in each block.").set_default(2);
+    size_t& text_lines = kwarg("l,lines", "Lines in each text field.").set_default(8);
+    uint64_t& seed = kwarg("s,seed", "Seed. The same seed and sizes always give the same file.").set_default(1);
+};
+
+
+int main(int argc, char* argv[])
+{
+    auto args = argparse::parse<GenArgs>(argc, argv);
+
+    row::bench::CorpusOptions opt{};
+    opt.blocks = args.blocks;
+    opt.sites = args.sites;
+    opt.aniso_fraction = args.aniso;
+    opt.profile_points = args.profile;
+    opt.text_fields = args.text_fields;
+    opt.text_lines = args.text_lines;
+    opt.seed = args.seed;
+
+    const std::string cif{ row::bench::generate_cif(opt) };
+    std::ofstream fout(args.dst_path, std::ios::binary);
+    fout << cif;
+    if (!fout) {
+        std::cerr << "Couldn't write " << args.dst_path << '\n';
+        return 1;
+    }
+    std::cout << "Wrote " << cif.size() << " bytes to " << args.dst_path << '\n';
+    return 0;
+}
@@ -0,0 +1,25 @@
+//Every allocation is counted for --profile. When nothing is being profiled on the thread, that's one
+// thread-local load and a branch. These are on their own, so the compiler can't see free() called on memory
+// from operator new, which it would warn about.
+
+#include <cstdlib>
+#include <new>
+
+#include "row/pdqciflib/profile.hpp"
+
+
+void* operator new(std::size_t size) {
+    row::util::count_allocation();
+    if (void* p{ std::malloc(size == 0 ? 1 : size) }) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
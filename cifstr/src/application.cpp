@@ -2,16 +2,45 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <format>
 #include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <optional>
 #include <filesystem>
+#include <chrono>
+#include <thread>
+#include <cstring>
 #include "argparse/argparse.hpp"
 
 #include "row/pdqciflib.hpp"
 #include "cifstr.hpp"
+#include "cache.hpp"
+#include "server.hpp"
 
 
+//points this thread's logger at out until it goes away, and then back at wherever it was before,
+// so a worker isn't left logging to a stream that's gone
+class LogTo {
+private:
+    std::ostream* m_previous;
+
+public:
+    explicit LogTo(std::ostream& out) : m_previous{ logger.out } {
+        logger.out = &out;
+    }
+
+    LogTo(const LogTo&) = delete;
+    LogTo& operator=(const LogTo&) = delete;
+
+    ~LogTo() {
+        logger.out = m_previous;
+    }
+};
+
 
 void info() {
 	constexpr std::string_view sv
@@ -69,7 +98,17 @@ void info() {
 	"The '-s' option adds a fixed Lorentzian crystallite size of 200 nm, and a refinable scale factor\n"
 	"of 0.0001 to allow for an easy start to a refinement. The '-a' option does all blocks present in a\n"
 	"CIF file. The '-m' option writes an output file for each block. The verbosity of the output to the screen\n"
-	"can be controlled with '-v'.\n"
+	"can be controlled with '-v'. The '-j' option converts that many files at the same time; the output is\n"
+	"still written in the order the files were given. Given only one file and '-a', it reads and converts\n"
+	"that many of the file's blocks at the same time instead. The '--profile' option writes how long each file\n"
+	"spent being parsed, having its numbers converted, having its ADPs worked out, being made into a\n"
+	"structure, and being written, along with how many allocations each of those made, to a JSON or CSV file.\n"
+	"The '--cache' option keeps the STR text made from each file in the given directory. If the file, and the\n"
+	"'-s' and '-a' options, are the same next time, the STR text is reused, and the file isn't read again.\n"
+	"\n"
+	"'cifstr --serve [socket] [-j N]' keeps running, and converts CIFs as they are asked for, either on stdin\n"
+	"and stdout, or from clients connecting to a Unix domain socket, N at a time. The requests and replies\n"
+	"are described in server.hpp.\n"
 	"\n"
 	"If you have any feedback, please contact me. If you find any bugs, please provide the CIF which\n"
 	"caused the error, a description of the error, and a description of how you believe the program\n"
@@ -89,6 +128,9 @@ struct MyArgs : public argparse::Args {
     bool& do_all_blocks = flag("a,all", "Do all the blocks in all the input_files.");                                       
     bool& write_many_files = flag("m,many", "Output each block as its own STR file. Uses output_file as the basename");     
     int& verbosity = kwarg("v,verbosity", "Verbosity of screen output: 0|1|2").set_default(1);
+    int& jobs = kwarg("j,jobs", "Number of files to convert at the same time, or, for one file with -a, blocks. Output is still written in input order.").set_default(1);
+    std::string& cache_dir = kwarg("cache", "Keep the STR text in this directory, and reuse it for input_files that haven't changed.").set_default("");
+    std::string& profile_path = kwarg("profile", "Write the time and allocations each file took in each phase to this file. JSON if it ends in .json, otherwise CSV.").set_default("");
     bool& print_info = flag("i,info", "Print information about what the program does.");                                       
 
     bool& printargs = flag("print", "A flag to toggle printing the argument values. Useful for debugging.");
@@ -98,21 +140,338 @@ struct MyArgs : public argparse::Args {
     }
 };
 
-void print_block_to_file(const std::string& name, const std::string& source, const row::cif::Block& block, int verbosity, bool stuff, std::ofstream& out) {
+//the structure in one block. Empty if the block couldn't be converted.
+// Its STR text isn't made until it's written out, unless it's going in the cache.
+struct ConvertedBlock {
+    std::string name{};
+    std::optional<CrystalStructure> str{};
+    std::optional<std::string> text{}; //used instead of str, if set
+};
+
+//everything a file produced, so it can be written out later, in order.
+struct ConvertedFile {
+    std::vector<ConvertedBlock> blocks{};
+    std::string out{};
+    std::string err{};
+    row::util::Profile profile{};
+};
+
+//what --profile collects: a profile for each file, in input order
+struct ProfileReport {
+    std::vector<std::pair<std::string, row::util::Profile>> files{};
+    uint64_t nanoseconds{ 0 }; //the whole run, which is less than the sum of the files if -j was used
+
+    row::util::Profile total() const {
+        row::util::Profile sum{};
+        for (const auto& [file, profile] : files) {
+            sum += profile;
+        }
+        return sum;
+    }
+};
+
+std::optional<CrystalStructure> convert_block(const std::string& name, const std::string& source, const row::cif::Block& block, int verbosity, bool stuff, std::ostream& out, std::ostream& err) {
     try {
-        if (verbosity > 0) { std::cout << name << '\n'; }
-        CrystalStructure str(block, name, source, verbosity, stuff);
-        out << str.to_string() << '\n';
+        if (verbosity > 0) { out << name << '\n'; }
+        const row::util::PhaseTimer timer{ row::util::Phase::Structure };
+        return CrystalStructure(block, name, source, verbosity, stuff);
     }
     catch (std::exception& e) {
 		if (verbosity > 0) {
-			std::cerr << e.what() << '\n';
-			std::cerr << "Continuing...\n";
+			err << e.what() << '\n';
+			err << "Continuing...\n";
 		}
     }
-	return;
+	return std::nullopt;
+}
+
+//each block is converted on the pool, with its screen output buffered, and then it's all put back in order
+std::vector<ConvertedBlock> convert_blocks_concurrently(const row::cif::Cif& cif, const MyArgs& args, row::util::ThreadPool& pool, std::ostream& out, std::ostream& err) {
+    struct Converted {
+        ConvertedBlock block{};
+        std::string out{};
+        std::string err{};
+        row::util::Profile profile{};
+    };
+    const bool profiling{ row::util::active_profile() != nullptr };
+
+    std::vector<std::future<Converted>> pending{};
+    for (const auto& item : cif) {
+        pending.push_back(pool.submit([&args, &cif, &item, profiling] {
+            std::ostringstream block_out{};
+            std::ostringstream block_err{};
+            const LogTo log_to{ block_out };
+            Converted converted{};
+            {
+                row::util::ProfileScope scope{ profiling ? &converted.profile : nullptr };
+                converted.block = { item.first, convert_block(item.first, cif.getSource(), item.second, args.verbosity, args.add_stuff, block_out, block_err) };
+            }
+            converted.out = block_out.str();
+            converted.err = block_err.str();
+            return converted;
+        }));
+    }
+
+    std::vector<ConvertedBlock> blocks{};
+    for (std::future<Converted>& next : pending) {
+        Converted converted{ next.get() };
+        out << converted.out;
+        err << converted.err;
+        if (row::util::Profile* profile{ row::util::active_profile() }) {
+            converted.profile.nanoseconds = 0; //the blocks overlapped, so only the phases add up
+            *profile += converted.profile;
+        }
+        blocks.push_back(std::move(converted.block));
+    }
+    return blocks;
+}
+
+//with a pool, and all the blocks wanted, the blocks are read and converted on it at the same time
+std::vector<ConvertedBlock> convert_file(const std::string& file, const MyArgs& args, std::ostream& out, std::ostream& err, row::util::ThreadPool* pool = nullptr) {
+    const LogTo log_to{ out };
+    std::vector<ConvertedBlock> blocks{};
+    try {
+        if (args.verbosity > 0) {
+            out << std::format("--------------------\nNow reading {0}. Block(s):\n", file);
+        }
+        row::cif::ParseOptions options{};
+        options.tags = &CrystalStructure::tag_filter(); //only keep what is needed to make the STR
+        if (!args.do_all_blocks) {
+            options.blocks = row::cif::BlockSelection::Last; //don't bother parsing blocks that won't be used
+        }
+        options.pool = pool;
+        thread_local row::cif::Parser parser{}; //each worker keeps its own, so its buffers are reused from file to file
+        row::cif::Cif cif = parser.read_file_mapped(file, false, args.verbosity > 0, err, options);
+        if (args.do_all_blocks && pool) {
+            blocks = convert_blocks_concurrently(cif, args, *pool, out, err);
+        }
+        else if (args.do_all_blocks) {
+            for (const auto& [name, block] : cif) {
+                blocks.push_back({ name, convert_block(name, cif.getSource(), block, args.verbosity, args.add_stuff, out, err) });
+            }
+        }
+        else {
+            blocks.push_back({ cif.getLastBlockName(), convert_block(cif.getLastBlockName(), cif.getSource(), cif.getLastBlock(), args.verbosity, args.add_stuff, out, err) });
+        }
+    }
+    catch (std::runtime_error& e) {
+		if (args.verbosity > 0) {
+			err << e.what() << '\n';
+			err << "Continuing with next file...\n";
+		}
+    }
+    return blocks;
+}
+
+//a hit skips reading and converting the file. A miss does both, and makes the STR text then, so it can be stored.
+std::vector<ConvertedBlock> convert_file_cached(const std::string& file, const MyArgs& args, ConversionCache& cache, std::ostream& out, std::ostream& err, row::util::ThreadPool* pool = nullptr) {
+    std::string key{};
+    try {
+        const tao::pegtl::mmap_input<> in(file);
+        key = ConversionCache::key(file, std::string_view(in.begin(), in.size()), args.add_stuff, args.do_all_blocks);
+    }
+    catch (std::exception&) {
+        return convert_file(file, args, out, err, pool); //so it can say what's wrong
+    }
+
+    std::vector<ConvertedBlock> blocks{};
+    if (std::optional<std::vector<CachedBlock>> cached{ cache.load(key) }) {
+        if (args.verbosity > 0) {
+            out << std::format("--------------------\nFound {0} in the cache. Block(s):\n", file);
+        }
+        for (CachedBlock& block : *cached) {
+            if (args.verbosity > 0) { out << block.name << '\n'; }
+            blocks.push_back({ std::move(block.name), std::nullopt, std::move(block.str) });
+        }
+        return blocks;
+    }
+
+    blocks = convert_file(file, args, out, err, pool);
+    if (blocks.empty()) {
+        return blocks; //it couldn't be read, so try again next time
+    }
+    std::vector<CachedBlock> to_store{};
+    for (ConvertedBlock& block : blocks) {
+        if (block.str) {
+            const row::util::PhaseTimer timer{ row::util::Phase::Output };
+            block.text = block.str->to_string();
+            block.str.reset();
+        }
+        to_store.push_back({ block.name, block.text });
+    }
+    cache.store(key, to_store);
+    return blocks;
+}
+
+void write_blocks(const std::vector<ConvertedBlock>& blocks, const MyArgs& args, std::ofstream& fout) {
+    const row::util::PhaseTimer timer{ row::util::Phase::Output }; //made first, so it also times the last flush
+    OutputSink sink{ fout };
+    for (const ConvertedBlock& block : blocks) {
+        if (args.write_many_files) {
+            sink.flush();
+            fout.close(); //close the previous instance
+            fout.open(args.dst_path + block.name + ".str");
+        }
+        if (block.text) {
+            sink.write(*block.text);
+            sink.put('\n');
+        }
+        else if (block.str) {
+            block.str->write_to(sink);
+            sink.put('\n');
+        }
+    }
+}
+
+std::string json_string(std::string_view s) {
+    std::string r{ "\"" };
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            r += '\\';
+            r += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            r += std::format("\\u{0:04x}", static_cast<int>(c));
+        }
+        else {
+            r += c;
+        }
+    }
+    r += '"';
+    return r;
+}
+
+std::string csv_string(std::string_view s) {
+    std::string r{ "\"" };
+    for (char c : s) {
+        r += c;
+        if (c == '"') {
+            r += '"';
+        }
+    }
+    r += '"';
+    return r;
+}
+
+double to_ms(uint64_t ns) {
+    return static_cast<double>(ns) / 1.0e6;
 }
 
+void write_profile_json(std::ostream& os, const std::string& name, const row::util::Profile& p, uint64_t nanoseconds) {
+    os << std::format("{{\"file\": {0}, \"wall_ms\": {1:.3f}, \"allocations\": {2}, \"bytes\": {3}, \"blocks\": {4}, \"loop_rows\": {5}, \"phases\": {{",
+                      json_string(name), to_ms(nanoseconds), p.allocations, p.bytes, p.blocks, p.loop_rows);
+    for (size_t i{ 0 }; i < row::util::phase_count; ++i) {
+        const row::util::PhaseStats& ph{ p.phases[i] };
+        os << std::format("{0}\"{1}\": {{\"calls\": {2}, \"ms\": {3:.3f}, \"allocations\": {4}}}",
+                          i == 0 ? "" : ", ", row::util::phase_names[i], ph.calls, to_ms(ph.nanoseconds), ph.allocations);
+    }
+    os << "}}";
+}
+
+void write_profile_csv(std::ostream& os, const std::string& name, const row::util::Profile& p, uint64_t nanoseconds) {
+    os << std::format("{0},{1:.3f},{2},{3},{4},{5}", csv_string(name), to_ms(nanoseconds), p.allocations, p.bytes, p.blocks, p.loop_rows);
+    for (const row::util::PhaseStats& ph : p.phases) {
+        os << std::format(",{0},{1:.3f},{2}", ph.calls, to_ms(ph.nanoseconds), ph.allocations);
+    }
+    os << '\n';
+}
+
+//one entry per file, then the total, whose wall time is for the whole run
+void write_profile(const ProfileReport& report, const std::string& path) {
+    std::ofstream os(path);
+    if (!os) {
+        std::cerr << std::format("Couldn't write the profile to {0}.\n", path);
+        return;
+    }
+    const row::util::Profile total{ report.total() };
+    if (path.ends_with(".json")) {
+        os << "{\"files\": [\n";
+        for (size_t i{ 0 }; i < report.files.size(); ++i) {
+            const auto& [file, profile] = report.files[i];
+            os << "  ";
+            write_profile_json(os, file, profile, profile.nanoseconds);
+            os << (i + 1 < report.files.size() ? ",\n" : "\n");
+        }
+        os << "],\n\"total\": ";
+        write_profile_json(os, "total", total, report.nanoseconds);
+        os << "}\n";
+        return;
+    }
+    os << "file,wall_ms,allocations,bytes,blocks,loop_rows";
+    for (std::string_view phase : row::util::phase_names) {
+        os << std::format(",{0}_calls,{0}_ms,{0}_allocations", phase);
+    }
+    os << '\n';
+    for (const auto& [file, profile] : report.files) {
+        write_profile_csv(os, file, profile, profile.nanoseconds);
+    }
+    write_profile_csv(os, "total", total, report.nanoseconds);
+}
+
+//files are converted on a pool of workers, with their screen output buffered, and then
+// everything is written out in the order the files were given.
+void convert_files_concurrently(const MyArgs& args, ConversionCache* cache, std::ofstream& fout, ProfileReport& report) {
+    row::util::ThreadPool pool(static_cast<size_t>(args.jobs));
+    const size_t max_pending{ 2 * pool.size() }; //don't hold too many finished files in memory
+    std::deque<std::future<ConvertedFile>> pending{};
+
+    auto write_next = [&] {
+        ConvertedFile converted{ pending.front().get() };
+        pending.pop_front();
+        std::cout << converted.out;
+        std::cerr << converted.err;
+        {
+            row::util::ProfileScope scope{ args.profile_path.empty() ? nullptr : &converted.profile };
+            write_blocks(converted.blocks, args, fout);
+        }
+        if (!args.profile_path.empty()) {
+            report.files.emplace_back(args.src_path[report.files.size()], converted.profile);
+        }
+    };
+
+    for (const std::string& file : args.src_path) {
+        pending.push_back(pool.submit([&args, cache, &file] {
+            std::ostringstream out{};
+            std::ostringstream err{};
+            ConvertedFile converted{};
+            {
+                row::util::ProfileScope scope{ args.profile_path.empty() ? nullptr : &converted.profile };
+                converted.blocks = cache ? convert_file_cached(file, args, *cache, out, err) : convert_file(file, args, out, err);
+            }
+            converted.out = out.str();
+            converted.err = err.str();
+            return converted;
+        }));
+        if (pending.size() >= max_pending) {
+            write_next();
+        }
+    }
+    while (!pending.empty()) {
+        write_next();
+    }
+}
+
+
+//cifstr --serve [socket] [-j N]
+int serve(int argc, char* argv[]) {
+    std::string socket{};
+    size_t jobs{ std::max(1u, std::thread::hardware_concurrency()) };
+    for (int i{ 2 }; i < argc; ++i) {
+        if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            jobs = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        }
+        else {
+            socket = argv[i];
+        }
+    }
+
+    if (socket.empty()) {
+        serve_stdio();
+        return 0;
+    }
+    std::cerr << serve_socket(socket, jobs) << '\n';
+    return 1;
+}
 
 int main(int argc, char* argv[])
 {
@@ -121,6 +480,9 @@ int main(int argc, char* argv[])
         info();
         exit(0);
 	}
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        return serve(argc, argv);
+    }
 
     auto args = argparse::parse<MyArgs>(argc, argv);
 
@@ -133,37 +495,45 @@ int main(int argc, char* argv[])
     
     std::ofstream fout(args.dst_path);
 
-    for (const std::string& file : args.src_path) { 
-        try {
-            if (args.verbosity > 0) {
-                std::cout << std::format("--------------------\nNow reading {0}. Block(s):\n", file);
-            }
-            row::cif::Cif cif = row::cif::read_file(file, false, args.verbosity > 0);
-            if (args.do_all_blocks) {
-                for (const auto& [name, block] : cif) {
-                    if (args.write_many_files) {
-                        fout.close();; //close the previous instance
-                        fout.open(args.dst_path + name + ".str");
-                    }
-                    print_block_to_file(name, cif.getSource(), block, args.verbosity, args.add_stuff, fout);
-                }
+    std::optional<ConversionCache> cache{};
+    if (!args.cache_dir.empty()) {
+        cache.emplace(args.cache_dir);
+    }
+
+    ProfileReport report{};
+    const auto start = std::chrono::steady_clock::now();
+
+    //with only one file to do, -j is used on its blocks instead
+    std::optional<row::util::ThreadPool> block_pool{};
+    if (args.jobs > 1 && args.src_path.size() == 1 && args.do_all_blocks) {
+        block_pool.emplace(static_cast<size_t>(args.jobs));
+    }
+
+    if (args.jobs > 1 && !block_pool) {
+        convert_files_concurrently(args, cache ? &*cache : nullptr, fout, report);
+    }
+    else {
+        row::util::ThreadPool* pool{ block_pool ? &*block_pool : nullptr };
+        for (const std::string& file : args.src_path) {
+            row::util::Profile profile{};
+            {
+                row::util::ProfileScope scope{ args.profile_path.empty() ? nullptr : &profile };
+                write_blocks(cache ? convert_file_cached(file, args, *cache, std::cout, std::cerr, pool) : convert_file(file, args, std::cout, std::cerr, pool), args, fout);
             }
-            else {
-                if (args.write_many_files) {
-                    fout.close();; //close the previous instance
-                    fout.open(args.dst_path + cif.getLastBlockName() + ".str");
-                }
-                print_block_to_file(cif.getLastBlockName(), cif.getSource(), cif.getLastBlock(), args.verbosity, args.add_stuff, fout);
+            if (!args.profile_path.empty()) {
+                report.files.emplace_back(file, profile);
             }
         }
-        catch (std::runtime_error& e) {
-			if (args.verbosity > 0) {
-				std::cerr << e.what() << '\n';
-				std::cerr << "Continuing with next file...\n";
-			}
-        }   
     }
 
+    if (!args.profile_path.empty()) {
+        report.nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        write_profile(report, args.profile_path);
+    }
+
+    if (cache && args.verbosity > 0) {
+        std::cout << std::format("Cache: {0} hit(s), {1} miss(es).\n", cache->hits(), cache->misses());
+    }
     if (args.verbosity > 0) {
         std::cout << "Thanks for using cifstr. For feedback, please contact rowlesmr@gmail.com\n";
     }
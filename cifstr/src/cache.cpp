@@ -0,0 +1,128 @@
+#include "cache.hpp"
+
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <system_error>
+#include <thread>
+
+#include "row/pdqciflib/util.hpp"
+
+
+
+ConversionCache::ConversionCache(std::filesystem::path dir)
+	: m_dir{ std::move(dir) }, m_salt{ std::random_device{}() }
+{
+	std::error_code ec{};
+	std::filesystem::create_directories(m_dir, ec);
+}
+
+std::string ConversionCache::key(const std::string_view file_name, const std::string_view bytes, bool add_stuff, bool do_all_blocks)
+{
+	const auto [a, b] = row::util::hash_bytes(bytes);
+	const auto [n, m] = row::util::hash_bytes(file_name);
+	return std::format("{0:016x}{1:016x}-{2:08x}{3}{4}", a, b, static_cast<uint32_t>(n ^ m), add_stuff ? 's' : '-', do_all_blocks ? 'a' : '-');
+}
+
+std::filesystem::path ConversionCache::path_for(const std::string& key) const
+{
+	return m_dir / (key + ".strcache");
+}
+
+//an entry is the magic line, the number of blocks, then for each block "<name length> <STR length, or -1>\n<name><STR>"
+std::optional<std::vector<CachedBlock>> ConversionCache::load(const std::string& key)
+{
+	auto miss = [this] {
+		++m_misses;
+		return std::nullopt;
+	};
+
+	std::ifstream in(path_for(key), std::ios::binary);
+	if (!in) {
+		return miss();
+	}
+	const std::string text{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+	if (!text.starts_with(magic)) {
+		return miss();
+	}
+
+	const char* p{ text.data() + magic.size() };
+	const char* const end{ text.data() + text.size() };
+	auto read_number = [&](auto& n, char after) {
+		auto [ptr, ec] = std::from_chars(p, end, n);
+		if (ec != std::errc{} || ptr == end || *ptr != after) {
+			return false;
+		}
+		p = ptr + 1;
+		return true;
+	};
+
+	size_t count{ 0 };
+	if (!read_number(count, '\n')) {
+		return miss();
+	}
+	std::vector<CachedBlock> blocks{};
+	for (size_t i{ 0 }; i < count; ++i) {
+		size_t name_len{ 0 };
+		long long str_len{ 0 };
+		if (!read_number(name_len, ' ') || !read_number(str_len, '\n')) {
+			return miss();
+		}
+		const size_t body{ name_len + (str_len > 0 ? static_cast<size_t>(str_len) : 0) };
+		if (static_cast<size_t>(end - p) < body) {
+			return miss();
+		}
+		CachedBlock& block{ blocks.emplace_back() };
+		block.name.assign(p, name_len);
+		p += name_len;
+		if (str_len >= 0) {
+			block.str.emplace(p, static_cast<size_t>(str_len));
+			p += str_len;
+		}
+	}
+	++m_hits;
+	return blocks;
+}
+
+void ConversionCache::store(const std::string& key, const std::vector<CachedBlock>& blocks)
+{
+	std::string text{ magic };
+	std::format_to(std::back_inserter(text), "{0}\n", blocks.size());
+	for (const CachedBlock& block : blocks) {
+		std::format_to(std::back_inserter(text), "{0} {1}\n", block.name.size(), block.str ? static_cast<long long>(block.str->size()) : -1LL);
+		text += block.name;
+		if (block.str) {
+			text += *block.str;
+		}
+	}
+
+	//the salt is random for each run, so other processes using the same directory won't pick the same name
+	const std::filesystem::path temp{ m_dir / std::format("{0}.{1:x}.{2:x}.{3}.tmp", key, m_salt, std::hash<std::thread::id>{}(std::this_thread::get_id()), m_temp_count++) };
+	{
+		std::ofstream out(temp, std::ios::binary);
+		out << text;
+		if (!out) {
+			std::error_code ec{};
+			std::filesystem::remove(temp, ec);
+			return;
+		}
+	}
+	std::error_code ec{};
+	std::filesystem::rename(temp, path_for(key), ec);
+	if (ec) {
+		std::filesystem::remove(temp, ec);
+	}
+}
+
+size_t ConversionCache::hits() const
+{
+	return m_hits.load();
+}
+
+size_t ConversionCache::misses() const
+{
+	return m_misses.load();
+}
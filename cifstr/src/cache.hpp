@@ -0,0 +1,51 @@
+#ifndef ROW_CIFSTR_CACHE_HPP
+#define ROW_CIFSTR_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+//the STR made from one block of a file. No text if the block couldn't be converted.
+struct CachedBlock {
+    std::string name{};
+    std::optional<std::string> str{};
+};
+
+//STR text kept on disk between runs, one entry per CIF, so files that haven't changed don't need to be
+// read or converted again. Entries are written to a temporary file and renamed into place, so two
+// processes or threads writing the same entry can't leave a half-written one behind.
+class ConversionCache {
+private:
+    std::filesystem::path m_dir{};
+    std::atomic<size_t> m_hits{ 0 };
+    std::atomic<size_t> m_misses{ 0 };
+    uint32_t m_salt{ 0 };
+    std::atomic<uint64_t> m_temp_count{ 0 };
+
+    static constexpr std::string_view magic{ "cifstr cache 1\n" }; //change this if the STR text changes
+
+public:
+    explicit ConversionCache(std::filesystem::path dir);
+
+    //The key covers everything that changes the STR text: the bytes of the file, the name the file was
+    // given by, which goes in the STR, and the flags that change what is written.
+    static std::string key(std::string_view file_name, std::string_view bytes, bool add_stuff, bool do_all_blocks);
+
+    //nullopt if there's no usable entry. Counts as a hit or a miss.
+    std::optional<std::vector<CachedBlock>> load(const std::string& key);
+    //failing to write is not an error; it'll just be a miss next time
+    void store(const std::string& key, const std::vector<CachedBlock>& blocks);
+
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    std::filesystem::path path_for(const std::string& key) const;
+};
+
+#endif
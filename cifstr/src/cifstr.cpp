@@ -1,15 +1,17 @@
 #include "cifstr.hpp"
 
+using namespace row::cif::literals;
 
 
-std::string& fix_atom_type_i(std::string& atom)
+
+std::string fix_atom_type(const std::string_view atom)
 {
 	auto m = ctre::match<"([A-Za-z]{1,2})(\\d{0,}\\.?\\d{0,})([+\\-]{0,1})(\\d{0,2})">(atom);
 
-	std::string symbol{ m.get<1>().to_string() };
-	std::string charge{ m.get<2>().to_string() };
-	std::string sign{ m.get<3>().to_string() };
-	std::string digit{ m.get<4>().to_string() };
+	const std::string_view symbol{ m.get<1>().to_view() };
+	std::string_view charge{ m.get<2>().to_view() };
+	std::string_view sign{ m.get<3>().to_view() };
+	const std::string_view digit{ m.get<4>().to_view() };
 
 	if (charge == "0") { // eg  "Si0+" is a valid symbol, but it is a neutral atom
 		charge = "";
@@ -20,19 +22,26 @@ std::string& fix_atom_type_i(std::string& atom)
 		if (digit.size() == 1)
 			charge = "1";
 		else //the atom was probably the right way around to begin with
-			return atom;
+			return std::string{ atom };
 	}
 
-	std::string new_atom = symbol + sign + charge;
-
-	if (contains(allowed_atoms, new_atom)) {
-		atom = new_atom;
-		return atom;
+	if (is_allowed_atom(symbol, sign, charge)) {
+		std::string new_atom{ symbol };
+		new_atom.append(sign).append(charge);
+		return new_atom;
 	}
 
-	logger.log(Logger::Verbosity::SOME, std::format("{0} is not a legal TOPAS scattering factor. Atom replaced with {1}.", new_atom, symbol));
-	atom = symbol;
+	if (logger.enabled(Logger::Verbosity::SOME)) {
+		std::string new_atom{ symbol };
+		new_atom.append(sign).append(charge);
+		logger.log(Logger::Verbosity::SOME, std::format("{0} is not a legal TOPAS scattering factor. Atom replaced with {1}.", new_atom, symbol));
+	}
+	return std::string{ symbol };
+}
 
+std::string& fix_atom_type_i(std::string& atom)
+{
+	atom = fix_atom_type(atom);
 	return atom;
 }
 
@@ -48,26 +57,40 @@ std::vector<std::string> fix_atom_types(std::vector<std::string> atoms)
 	return atoms;
 }
 
+std::vector<std::string> fix_atom_types(std::span<const std::string_view> atoms)
+{
+	std::vector<std::string> fixed{};
+	fixed.reserve(atoms.size());
+	for (const std::string_view atom : atoms) {
+		fixed.push_back(fix_atom_type(atom));
+	}
+	return fixed;
+}
+
 std::string& label_to_atom_i(std::string& label)
 {
-	if (contains(water, label.substr(0, 3))) {
-		logger.log(Logger::Verbosity::SOME, std::format("Site label '{0}' probably means 'water'. Please check that this atom really is oxygen.", label));
+	const std::string_view view{ label };
+	if (contains(water, view.substr(0, 3))) {
+		if (logger.enabled(Logger::Verbosity::SOME)) {
+			logger.log(Logger::Verbosity::SOME, std::format("Site label '{0}' probably means 'water'. Please check that this atom really is oxygen.", label));
+		}
 		label = "O";
 		return label;
 	}
-	if (contains(elements, label.substr(0, 2))) {
-		label = label.substr(0, 2);
+	if (const std::string_view two{ view.substr(0, 2) }; is_element(two)) {
+		label.resize(two.size());
 		return label;
 	}
-	if (contains(elements, label.substr(0, 1))) {
-		std::string tmp = label.substr(0, 1);
-		if (tmp == "W")
+	if (is_element(view.substr(0, 1))) {
+		if (label[0] == 'W' && logger.enabled(Logger::Verbosity::SOME))
 			logger.log(Logger::Verbosity::SOME, std::format("W detected for site '{0}'. Do you mean oxygen from a water molecule or tungsten? Please check.", label));
-		label = tmp;
+		label.resize(1);
 		return label;
 	}
 
-	logger.log(Logger::Verbosity::SOME, std::format("Can't decide what atom the site label '{0}' should be. Please check it.", label));
+	if (logger.enabled(Logger::Verbosity::SOME)) {
+		logger.log(Logger::Verbosity::SOME, std::format("Can't decide what atom the site label '{0}' should be. Please check it.", label));
+	}
 	return label;
 }
 
@@ -83,44 +106,86 @@ std::vector<std::string> labels_to_atoms(std::vector<std::string> labels)
 	return labels;
 }
 
-std::string& make_frac_i(std::string& coord, const std::string_view label/*=""*/)
+std::optional<FractionMatch> classify_fraction(const std::string_view coord, std::span<const FractionPattern> patterns /*=special_fractions*/)
 {
-	std::string r{};
-	if (auto m1 = ctre::match<"^([+\\-]?)0?\\.16{2,}[67]$">(coord)) {
-		r = std::format("={0}1/6;", m1.get<1>().to_string());
+	//the sign, then an optional 0, then the decimal point
+	size_t p{ 0 };
+	std::string_view sign{};
+	if (p < coord.size() && (coord[p] == '+' || coord[p] == '-')) {
+		sign = coord.substr(p, 1);
+		++p;
 	}
-	else if (auto m2 = ctre::match<"^([+\\-]?)0?\\.3{4,}$">(coord)) {
-		r = std::format("={0}1/3;", m2.get<1>().to_string());
+	if (p < coord.size() && coord[p] == '0') {
+		++p;
 	}
-	else if (auto m3 = ctre::match<"^([+\\-]?)0?\\.6{3,}[67]$">(coord)) {
-		r = std::format("={0}2/3;", m3.get<1>().to_string());
+	if (p >= coord.size() || coord[p] != '.') {
+		return std::nullopt;
 	}
-	else if (auto m4 = ctre::match<"^([+\\-]?)0?\\.83{3,}$">(coord)) {
-		r = std::format("={0}5/6;", m4.get<1>().to_string());
+	const std::string_view digits{ coord.substr(p + 1) };
+
+	for (const FractionPattern& pattern : patterns) {
+		if (!digits.starts_with(pattern.lead)) {
+			continue;
+		}
+		const std::string_view rest{ digits.substr(pattern.lead.size()) };
+		size_t run{ 0 };
+		while (run < rest.size() && rest[run] == pattern.repeat) {
+			++run;
+		}
+		if (run == rest.size()) {
+			//nothing but repeats. If there should be a last digit, the final repeat has to do as it.
+			const bool matched{ pattern.last.empty() ? run >= pattern.min_repeats :
+				run > pattern.min_repeats && pattern.last.find(pattern.repeat) != std::string_view::npos };
+			if (matched) {
+				return FractionMatch{ sign, pattern.fraction };
+			}
+		}
+		else if (run + 1 == rest.size() && run >= pattern.min_repeats && pattern.last.find(rest[run]) != std::string_view::npos) {
+			return FractionMatch{ sign, pattern.fraction };
+		}
 	}
+	return std::nullopt;
+}
+
+std::optional<std::string> fraction_for(const std::string_view coord, const std::string_view label/*=""*/, std::span<const FractionPattern> patterns /*=special_fractions*/)
+{
+	std::optional<FractionMatch> match{ classify_fraction(coord, patterns) };
+	if (!match) {
+		return std::nullopt;
+	}
+
+	std::string r{ "=" };
+	r.append(match->sign).append(match->fraction).append(";");
 
-	if (!r.empty()) {
+	if (logger.enabled(Logger::Verbosity::ALL)) {
 		if (label.empty()) {
 			logger.log(Logger::Verbosity::ALL, std::format("Atomic site coordinate '{0}' replaced by '{1}'.", coord, r));
 		}
 		else {
 			logger.log(Logger::Verbosity::ALL, std::format("Atomic fractional coordinate '{0}' replaced by '{1}' for site {2}.", coord, r, label));
 		}
-		coord = r;
+	}
+	return r;
+}
+
+std::string& make_frac_i(std::string& coord, const std::string_view label/*=""*/, std::span<const FractionPattern> patterns /*=special_fractions*/)
+{
+	if (std::optional<std::string> fraction{ fraction_for(coord, label, patterns) }) {
+		coord = std::move(*fraction);
 	}
 	return coord;
 }
 
-std::vector<std::string>& make_frac_i(std::vector<std::string>& v)
+std::vector<std::string>& make_frac_i(std::vector<std::string>& v, std::span<const FractionPattern> patterns /*=special_fractions*/)
 {
-	std::for_each(v.begin(), v.end(), [](std::string& s) { make_frac_i(s); });
+	std::for_each(v.begin(), v.end(), [patterns](std::string& s) { make_frac_i(s, "", patterns); });
 	return v;
 }
 
-std::vector<std::string>& make_frac_i(std::vector<std::string>& coords, const std::vector<std::string>& labels)
+std::vector<std::string>& make_frac_i(std::vector<std::string>& coords, const std::vector<std::string>& labels, std::span<const FractionPattern> patterns /*=special_fractions*/)
 {
 	for (size_t i{ 0 }; i < coords.size(); ++i) {
-		make_frac_i(coords[i], labels[i]);
+		make_frac_i(coords[i], labels[i], patterns);
 	}
 	return coords;
 }
@@ -137,6 +202,103 @@ std::vector<std::string> make_frac(std::vector<std::string> coords, const std::v
 	return coords;
 }
 
+OutputSink::OutputSink(std::ostream& os, size_t flush_at /*= 64 * 1024*/)
+	: m_os{ &os }, m_flush_at{ flush_at }
+{
+	m_buf.reserve(flush_at);
+}
+
+OutputSink::~OutputSink()
+{
+	flush();
+}
+
+void OutputSink::write(const std::string_view sv)
+{
+	m_buf.append(sv);
+	flush_if_full();
+}
+
+void OutputSink::put(const char c)
+{
+	m_buf.push_back(c);
+	flush_if_full();
+}
+
+void OutputSink::put(const char c, const size_t count)
+{
+	m_buf.append(count, c);
+	flush_if_full();
+}
+
+void OutputSink::flush()
+{
+	if (m_os && !m_buf.empty()) {
+		m_os->write(m_buf.data(), static_cast<std::streamsize>(m_buf.size()));
+		m_buf.clear(); //keeps the capacity for next time
+	}
+}
+
+std::string OutputSink::take()
+{
+	std::string s{};
+	s.swap(m_buf);
+	return s;
+}
+
+std::string_view OutputSink::view() const
+{
+	return m_buf;
+}
+
+void OutputSink::clear()
+{
+	m_buf.clear();
+}
+
+void OutputSink::flush_if_full()
+{
+	if (m_os && m_buf.size() >= m_flush_at) {
+		flush();
+	}
+}
+
+void ColumnWidth::add(const std::string_view s)
+{
+	if (s.starts_with('-')) {
+		m_any_negative = true;
+		m_max_negative = std::max(m_max_negative, s.size());
+	}
+	else {
+		m_max_other = std::max(m_max_other, s.size());
+	}
+}
+
+void ColumnWidth::write(OutputSink& out, const std::string_view s) const
+{
+	const size_t width{ std::max(m_max_negative, m_max_other + (m_any_negative ? 1 : 0)) };
+	size_t len{ s.size() };
+	if (m_any_negative && !s.starts_with('-')) {
+		out.put(' ');
+		++len;
+	}
+	out.write(s);
+	if (len < width) {
+		out.put(' ', width - len);
+	}
+}
+
+void SiteLayout::add(const Site& site)
+{
+	label.add(site.label);
+	x.add(site.x);
+	y.add(site.y);
+	z.add(site.z);
+	atom.add(site.atom);
+	occ.add(site.occ);
+	beq.add(site.beq);
+}
+
 double triple_product(Vec3 a, Vec3 b, Vec3 c)
 {
 	return a.dot_product(b.cross_product(c));
@@ -225,19 +387,26 @@ UnitCellVectors::UnitCellVectors(double av, double bv, double cv, double alv, do
 
 UnitCell::UnitCell(const row::cif::Block& block)
 {
-	a_s = strip_brackets(block.getValue("_cell_length_a").getStrings()[0]);
-	b_s = strip_brackets(block.getValue("_cell_length_b").getStrings()[0]);
-	c_s = strip_brackets(block.getValue("_cell_length_c").getStrings()[0]);
-	al_s = strip_brackets(block.getValue("_cell_angle_alpha").getStrings()[0]);
-	be_s = strip_brackets(block.getValue("_cell_angle_beta").getStrings()[0]);
-	ga_s = strip_brackets(block.getValue("_cell_angle_gamma").getStrings()[0]);
-
-	a = block.getValue("_cell_length_a").getDoubles()[0];
-	b = block.getValue("_cell_length_b").getDoubles()[0];
-	c = block.getValue("_cell_length_c").getDoubles()[0];
-	al = block.getValue("_cell_angle_alpha").getDoubles()[0];
-	be = block.getValue("_cell_angle_beta").getDoubles()[0];
-	ga = block.getValue("_cell_angle_gamma").getDoubles()[0];
+	const row::cif::Datavalue& a_v{ block.getValue("_cell_length_a"_tag) };
+	const row::cif::Datavalue& b_v{ block.getValue("_cell_length_b"_tag) };
+	const row::cif::Datavalue& c_v{ block.getValue("_cell_length_c"_tag) };
+	const row::cif::Datavalue& al_v{ block.getValue("_cell_angle_alpha"_tag) };
+	const row::cif::Datavalue& be_v{ block.getValue("_cell_angle_beta"_tag) };
+	const row::cif::Datavalue& ga_v{ block.getValue("_cell_angle_gamma"_tag) };
+
+	a_s = strip_brackets(std::string{ a_v.view_at(0) });
+	b_s = strip_brackets(std::string{ b_v.view_at(0) });
+	c_s = strip_brackets(std::string{ c_v.view_at(0) });
+	al_s = strip_brackets(std::string{ al_v.view_at(0) });
+	be_s = strip_brackets(std::string{ be_v.view_at(0) });
+	ga_s = strip_brackets(std::string{ ga_v.view_at(0) });
+
+	a = a_v.dbl_at(0);
+	b = b_v.dbl_at(0);
+	c = c_v.dbl_at(0);
+	al = al_v.dbl_at(0);
+	be = be_v.dbl_at(0);
+	ga = ga_v.dbl_at(0);
 
 	crystal_system = deduce_symmetry();
 	usv = UnitCellVectors(a, b, c, al, be, ga);
@@ -259,31 +428,48 @@ const UnitCellVectors& UnitCell::get_unitcellvectors() const
 }
 
 std::string UnitCell::to_string(size_t indent /*= 2*/) const
+{
+	OutputSink out{};
+	write_to(out, indent);
+	return out.take();
+}
+
+void UnitCell::write_to(OutputSink& out, size_t indent /*= 2*/) const
 {
 	std::string tabs(indent, '\t');
 
 	switch (crystal_system)
 	{
 	case CrystalSystem::Triclinic:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}\n{0}be {5}\t' {5}\n{0}ga {6}\t' {6}", tabs, a_s, b_s, c_s, al_s, be_s, ga_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}\n{0}be {5}\t' {5}\n{0}ga {6}\t' {6}", tabs, a_s, b_s, c_s, al_s, be_s, ga_s);
+		break;
 	case CrystalSystem::Monoclinic_al:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}", tabs, a_s, b_s, c_s, al_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}", tabs, a_s, b_s, c_s, al_s);
+		break;
 	case CrystalSystem::Monoclinic_be:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}be {4}\t' {4}", tabs, a_s, b_s, c_s, be_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}be {4}\t' {4}", tabs, a_s, b_s, c_s, be_s);
+		break;
 	case CrystalSystem::Monoclinic_ga:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}ga {4}\t' {4}", tabs, a_s, b_s, c_s, ga_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}ga {4}\t' {4}", tabs, a_s, b_s, c_s, ga_s);
+		break;
 	case CrystalSystem::Orthorhombic:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}", tabs, a_s, b_s, c_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}", tabs, a_s, b_s, c_s);
+		break;
 	case CrystalSystem::Tetragonal:
-		return std::format("{0}Tetragonal({1}, {2}) ' {1}, {2}", tabs, a_s, c_s);
+		out.print("{0}Tetragonal({1}, {2}) ' {1}, {2}", tabs, a_s, c_s);
+		break;
 	case CrystalSystem::Hexagonal:
-		return std::format("{0}Hexagonal({1}, {2}) ' {1}, {2}", tabs, a_s, c_s);
+		out.print("{0}Hexagonal({1}, {2}) ' {1}, {2}", tabs, a_s, c_s);
+		break;
 	case CrystalSystem::Rhombohedral:
-		return std::format("{0}Rhombohedral({1}, {2}) ' {1}, {2}", tabs, a_s, al_s);
+		out.print("{0}Rhombohedral({1}, {2}) ' {1}, {2}", tabs, a_s, al_s);
+		break;
 	case CrystalSystem::Cubic:
-		return std::format("{0}Cubic({1}) ' {1}", tabs, a_s);
+		out.print("{0}Cubic({1}) ' {1}", tabs, a_s);
+		break;
 	default:
-		return std::format("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}\n{0}be {5}\t' {5}\n{0}ga {6}\t' {6}", tabs, a_s, b_s, c_s, al_s, be_s, ga_s);
+		out.print("{0}a  {1}\t' {1}\n{0}b  {2}\t' {2}\n{0}c  {3}\t' {3}\n{0}al {4}\t' {4}\n{0}be {5}\t' {5}\n{0}ga {6}\t' {6}", tabs, a_s, b_s, c_s, al_s, be_s, ga_s);
+		break;
 	}
 }
 
@@ -319,310 +505,327 @@ CrystalSystem UnitCell::deduce_symmetry() const
 	return CrystalSystem::Triclinic;
 }
 
-Site::Site(std::string t_label, std::string t_x, std::string t_y, std::string t_z, std::string t_atom, std::string t_occ, std::string t_beq) 
-	: label{ std::move(t_label) }, x{ std::move(t_x) }, y{ std::move(t_y) }, z{ std::move(t_z) },
-	  atom{ std::move(t_atom) }, occ{ std::move(t_occ) }, beq{ std::move(t_beq) }
+BeqResolver::BeqResolver(const row::cif::Block& block)
 {
-	std::replace(label.begin(), label.end(), '\'', 'p'); //can't contain a "'", as this is a comment character in TOPAS
-}
+	const row::cif::Datavalue& labels{ block.getValue("_atom_site_label"_tag) };
+	const size_t n{ labels.size() };
 
-std::string Site::to_string(size_t indent /*= 2*/) const
-{
-	std::string tabs(indent, '\t');
-	return std::format("{0}site {1} num_posns 0\tx {2} y {3} z {4} occ {5} {6} beq {7}", tabs, label, x, y, z, atom, occ, beq);
+	//the isotropic values are in the same loop as the labels
+	const row::cif::Datavalue* biso{ block.find("_atom_site_B_iso_or_equiv"_tag) };
+	const row::cif::Datavalue* uiso{ block.find("_atom_site_U_iso_or_equiv"_tag) };
+	if (biso) {
+		size_t NAs{ 0 };
+		for (const std::string_view b : biso->getViews()) {
+			if (contains(NA_values, b.substr(0, b.find('(')))) ++NAs;
+		}
+		if (NAs > 0) {
+			logger.log(Logger::Verbosity::ALL, std::format("{0} missing Biso values.", NAs));
+		}
+		if (biso->size() == n) {
+			m_columns[0] = { biso, nullptr, nullptr };
+		}
+	}
+	if (uiso) {
+		size_t NAs{ 0 };
+		for (const std::string_view u : uiso->getViews()) {
+			if (contains(NA_values, u)) ++NAs;
+		}
+		if (NAs > 0) {
+			logger.log(Logger::Verbosity::ALL, std::format("{0} missing Uiso values.", NAs));
+		}
+		if (uiso->size() == n) {
+			m_columns[1] = { uiso, nullptr, nullptr };
+		}
+	}
+
+	//the anisotropic ones are in their own loop, and need all three diagonal terms
+	const row::cif::Datavalue* aniso_labels{ block.find("_atom_site_aniso_label"_tag) };
+	auto aniso = [&](const size_t i, const row::cif::TagKey& t11, const row::cif::TagKey& t22, const row::cif::TagKey& t33) {
+		const row::cif::Datavalue* v11{ block.find(t11) };
+		if (!v11) {
+			return;
+		}
+		const row::cif::Datavalue* v22{ &block.getValue(t22) };
+		const row::cif::Datavalue* v33{ &block.getValue(t33) };
+		if (aniso_labels && v11->size() == aniso_labels->size()) {
+			m_columns[i] = { v11, v22, v33 };
+		}
+	};
+	aniso(2, "_atom_site_aniso_B_11"_tag, "_atom_site_aniso_B_22"_tag, "_atom_site_aniso_B_33"_tag);
+	aniso(3, "_atom_site_aniso_U_11"_tag, "_atom_site_aniso_U_22"_tag, "_atom_site_aniso_U_33"_tag);
+	aniso(4, "_atom_site_aniso_beta_11"_tag, "_atom_site_aniso_beta_22"_tag, "_atom_site_aniso_beta_33"_tag);
+
+	if (m_columns[4][0]) {
+		const UnitCellVectors usv = UnitCellVectors(block.getValue("_cell_length_a"_tag).dbl_at(0),
+			block.getValue("_cell_length_b"_tag).dbl_at(0),
+			block.getValue("_cell_length_c"_tag).dbl_at(0),
+			block.getValue("_cell_angle_alpha"_tag).dbl_at(0),
+			block.getValue("_cell_angle_beta"_tag).dbl_at(0),
+			block.getValue("_cell_angle_gamma"_tag).dbl_at(0));
+		m_mas = usv.as.square_magnitude();
+		m_mbs = usv.bs.square_magnitude();
+		m_mcs = usv.cs.square_magnitude();
+	}
+
+	//a label used twice gets the values of its first row
+	std::unordered_map<std::string_view, size_t> first_row{};
+	first_row.reserve(n);
+	m_iso_row.resize(n);
+	for (size_t i{ 0 }; i < n; ++i) {
+		m_iso_row[i] = first_row.try_emplace(labels.view_at(i), i).first->second;
+	}
+
+	m_aniso_row.assign(n, npos);
+	if (aniso_labels && (m_columns[2][0] || m_columns[3][0] || m_columns[4][0])) {
+		for (size_t r{ 0 }; r < aniso_labels->size(); ++r) {
+			auto it = first_row.find(aniso_labels->view_at(r));
+			if (it != first_row.end() && m_aniso_row[it->second] == npos) {
+				m_aniso_row[it->second] = r;
+			}
+		}
+	}
 }
 
-Sites::Sites(const row::cif::Block& block)
+std::optional<std::pair<std::string, BeqSource>> BeqResolver::resolve(const size_t site) const
 {
-	std::vector<std::string> labels{ block.getValue("_atom_site_label").getStrings() };
-	std::vector<std::string> xs{ block.getValue("_atom_site_fract_x").getStrings() };
-	std::vector<std::string> ys{ block.getValue("_atom_site_fract_y").getStrings() };
-	std::vector<std::string> zs{ block.getValue("_atom_site_fract_z").getStrings() };
-
-	pad_column_i(strip_brackets_i(make_frac_i(xs, labels)));
-	pad_column_i(strip_brackets_i(make_frac_i(ys, labels)));
-	pad_column_i(strip_brackets_i(make_frac_i(zs, labels)));
-	pad_column_i(labels);
-
-	std::vector<std::string> atoms{ get_atoms(block) };
-	std::vector<std::string> occs{ get_occs(block) };
-	std::vector<std::string> beqs{ get_Beqs(block) };
+	static const std::array bad_vals{ "nan", "0.000", ".", "?" };
 
-	m_sites.reserve(labels.size());
-	for (size_t i{ 0 }; i < labels.size(); ++i) {
-		m_sites.emplace_back(labels[i], xs[i], ys[i], zs[i], atoms[i], occs[i], beqs[i]);
+	for (size_t i{ 0 }; i < source_count; ++i) {
+		if (!m_columns[i][0]) {
+			continue;
+		}
+		const size_t row{ i < 2 ? m_iso_row[site] : m_aniso_row[m_iso_row[site]] };
+		if (row == npos) {
+			continue;
+		}
+		const BeqSource source{ static_cast<BeqSource>(i) };
+		std::string beq{ value(source, row) };
+		if (!contains(bad_vals, beq)) {
+			return std::make_pair(std::move(beq), source);
+		}
 	}
-
-	m_ss = create_string();
+	return std::nullopt;
 }
 
-const std::string& Sites::to_string() const
+std::string BeqResolver::value(const BeqSource source, const size_t row) const
 {
-	return m_ss;
+	const std::array<const row::cif::Datavalue*, 3>& c{ m_columns[static_cast<size_t>(source)] };
+	switch (source)
+	{
+	case BeqSource::B_iso: {
+		const std::string_view b{ c[0]->view_at(row) };
+		return std::string{ b.substr(0, b.find('(')) };
+	}
+	case BeqSource::U_iso:
+		return std::format("{:.3f}", c[0]->dbl_at(row) * as_B);
+	case BeqSource::B_aniso:
+		return std::format("{:.3f}", (c[0]->dbl_at(row) + c[1]->dbl_at(row) + c[2]->dbl_at(row)) / 3.0);
+	case BeqSource::U_aniso:
+		return std::format("{:.3f}", (c[0]->dbl_at(row) + c[1]->dbl_at(row) + c[2]->dbl_at(row)) / 3.0 * as_B);
+	case BeqSource::Beta_aniso:
+		return std::format("{:.3f}", (4.0 * c[0]->dbl_at(row) / m_mas + 4.0 * c[1]->dbl_at(row) / m_mbs + 4.0 * c[2]->dbl_at(row) / m_mcs) / 3.0);
+	default:
+		return std::string{};
+	}
 }
 
-std::optional<std::vector<std::string>> Sites::get_Biso(const row::cif::Block& block)
+Site::Site(std::string_view t_label, std::string_view t_x, std::string_view t_y, std::string_view t_z, std::string_view t_atom, std::string_view t_occ, std::string_view t_beq) 
+	: label{ t_label }, x{ t_x }, y{ t_y }, z{ t_z }, atom{ t_atom }, occ{ t_occ }, beq{ t_beq }
 {
-	if (!block.contains("_atom_site_B_iso_or_equiv"))
-		return std::nullopt;
 
-	std::vector<std::string> beq{ block.getValue("_atom_site_B_iso_or_equiv").getStrings() };
-	strip_brackets_i(beq);
-
-	size_t NAs{ 0 };
-	std::for_each(beq.begin(), beq.end(), [&NAs](const std::string& b) {if (contains(NA_values, b)) ++NAs; });
-
-	if (NAs > 0) {
-		logger.log(Logger::Verbosity::ALL, std::format("{0} missing Biso values.", NAs));
-	}
-	return beq;
 }
 
-std::optional<std::vector<std::string>> Sites::get_Uiso_as_B(const row::cif::Block& block)
+std::string Site::to_string(size_t indent /*= 2*/) const
 {
-	if (!block.contains("_atom_site_U_iso_or_equiv"))
-		return std::nullopt;
-
-	size_t NAs{ 0 };
-	const std::vector<std::string>& ueq{ block.getValue("_atom_site_U_iso_or_equiv").getStrings() };
-	std::for_each(ueq.begin(), ueq.end(), [&NAs](const std::string& u) { if (contains(NA_values, u)) ++NAs;  });
-
-	if (NAs > 0) {
-		logger.log(Logger::Verbosity::ALL, std::format("{0} missing Uiso values.", NAs));
-	}
-
-	const std::vector<double>& ueq_dbl{ block.getValue("_atom_site_U_iso_or_equiv").getDoubles() };
-	std::vector<std::string> r{};
-	r.resize(ueq_dbl.size());
-	std::transform(ueq_dbl.cbegin(), ueq_dbl.cend(), r.begin(), [](double d) { return std::format("{:.3f}", d * as_B); });
-
-	return r;
+	OutputSink out{};
+	write_to(out, {}, indent);
+	return out.take();
 }
 
-std::optional<std::vector<std::string>> Sites::get_Baniso_as_B(const row::cif::Block& block)
+void Site::write_to(OutputSink& out, const SiteLayout& layout /*= {}*/, size_t indent /*= 2*/) const
 {
-	if (!block.contains("_atom_site_aniso_B_11"))
-		return std::nullopt;
-
-	std::vector<double> B11{ block.getValue("_atom_site_aniso_B_11").getDoubles() };
-	std::vector<double> B22{ block.getValue("_atom_site_aniso_B_22").getDoubles() };
-	std::vector<double> B33{ block.getValue("_atom_site_aniso_B_33").getDoubles() };
-	std::vector<double> beq;
-	beq.reserve(B11.size());
-
-	for (size_t i{ 0 }; i < B11.size(); ++i) {
-		beq.push_back((B11[i] + B22[i] + B33[i]) / 3.0);
-	}
-
-	std::vector<std::string> r{};
-	r.resize(beq.size());
-	std::transform(beq.cbegin(), beq.cend(), r.begin(), [](double d) { return std::format("{:.3f}", d); });
-
-	return r;
+	out.put('\t', indent);
+	out.write("site ");
+	layout.label.write(out, label);
+	out.write(" num_posns 0\tx ");
+	layout.x.write(out, x);
+	out.write(" y ");
+	layout.y.write(out, y);
+	out.write(" z ");
+	layout.z.write(out, z);
+	out.write(" occ ");
+	layout.atom.write(out, atom);
+	out.put(' ');
+	layout.occ.write(out, occ);
+	out.write(" beq ");
+	layout.beq.write(out, beq);
 }
 
-std::optional<std::vector<std::string>> Sites::get_Uaniso_as_B(const row::cif::Block& block)
+Sites::Sites(const row::cif::Block& block)
 {
-	if (!block.contains("_atom_site_aniso_U_11"))
-		return std::nullopt;
+	const row::cif::Datavalue& label_column{ block.getValue("_atom_site_label"_tag) };
+	const std::span<const std::string_view> labels{ label_column.getViews() };
+	const bool keep_labels{ keep(label_column) };
 
-	std::vector<double> U11{ block.getValue("_atom_site_aniso_U_11").getDoubles() };
-	std::vector<double> U22{ block.getValue("_atom_site_aniso_U_22").getDoubles() };
-	std::vector<double> U33{ block.getValue("_atom_site_aniso_U_33").getDoubles() };
-	std::vector<double> ueq;
-	ueq.reserve(U11.size());
-
-	for (size_t i{ 0 }; i < U11.size(); ++i) {
-		ueq.push_back((U11[i] + U22[i] + U33[i]) / 3.0);
+	m_sites.reserve(labels.size());
+	for (const std::string_view label : labels) {
+		m_sites.emplace_back(label, "", "", "", "", "", "");
+	}
+	read_coords(block.getValue("_atom_site_fract_x"_tag), labels, &Site::x);
+	read_coords(block.getValue("_atom_site_fract_y"_tag), labels, &Site::y);
+	read_coords(block.getValue("_atom_site_fract_z"_tag), labels, &Site::z);
+	read_atoms(block, labels, keep_labels);
+	read_occs(block);
+	read_Beqs(block, labels);
+
+	//nothing is padded until it's written
+	for (Site& site : m_sites) {
+		if (site.label.find('\'') != std::string_view::npos) { //can't contain a "'", as this is a comment character in TOPAS
+			std::string label{ site.label };
+			std::replace(label.begin(), label.end(), '\'', 'p');
+			site.label = m_text.store(label);
+		}
+		else {
+			site.label = hold(site.label, keep_labels);
+		}
+		m_layout.add(site);
 	}
-
-	std::vector<std::string> r{};
-	r.resize(ueq.size());
-	std::transform(ueq.cbegin(), ueq.cend(), r.begin(), [](double d) { return std::format("{:.3f}", d * as_B); });
-
-	return r;
 }
 
-std::optional<std::vector<std::string>> Sites::get_BEaniso_as_B(const row::cif::Block& block)
+std::string Sites::to_string() const
 {
-	if (!block.contains("_atom_site_aniso_beta_11"))
-		return std::nullopt;
-
-	std::vector<double> BE11{ block.getValue("_atom_site_aniso_beta_11").getDoubles() };
-	std::vector<double> BE22{ block.getValue("_atom_site_aniso_beta_22").getDoubles() };
-	std::vector<double> BE33{ block.getValue("_atom_site_aniso_beta_33").getDoubles() };
-
-	const UnitCellVectors usv = UnitCellVectors(block.getValue("_cell_length_a").getDoubles()[0],
-		block.getValue("_cell_length_b").getDoubles()[0],
-		block.getValue("_cell_length_c").getDoubles()[0],
-		block.getValue("_cell_angle_alpha").getDoubles()[0],
-		block.getValue("_cell_angle_beta").getDoubles()[0],
-		block.getValue("_cell_angle_gamma").getDoubles()[0]);
-
-	const double mas{ usv.as.square_magnitude() };
-	const double mbs{ usv.bs.square_magnitude() };
-	const double mcs{ usv.cs.square_magnitude() };
-
-	std::transform(BE11.begin(), BE11.end(), BE11.begin(), [&mas](double be) { return 4.0 * be / mas; });
-	std::transform(BE22.begin(), BE22.end(), BE22.begin(), [&mbs](double be) { return 4.0 * be / mbs; });
-	std::transform(BE33.begin(), BE33.end(), BE33.begin(), [&mcs](double be) { return 4.0 * be / mcs; });
+	OutputSink out{};
+	write_to(out);
+	return out.take();
+}
 
-	std::vector<double> beeq;
-	beeq.reserve(BE11.size());
-	for (size_t i{ 0 }; i < BE11.size(); ++i) {
-		beeq.push_back((BE11[i] + BE22[i] + BE33[i]) / 3.0);
+void Sites::write_to(OutputSink& out, size_t indent /*= 2*/) const
+{
+	for (const Site& site : m_sites) {
+		site.write_to(out, m_layout, indent);
+		out.put('\n');
 	}
-
-	std::vector<std::string> r{};
-	r.resize(beeq.size());
-	std::transform(beeq.cbegin(), beeq.cend(), r.begin(), [](double d) { return std::format("{:.3f}", d); });
-
-	return r;
 }
 
-std::unordered_map<std::string, std::string> Sites::make_beq_dict(const row::cif::Block& block, const std::string& b_type)
+bool Sites::keep(const row::cif::Datavalue& column)
 {
-	bool iso = true;
-
-	auto f{ get_Biso }; // if you ask for the wrong thing, just go for the base case.
-
-	if (b_type == "b_iso")
-		f = get_Biso;
-	else if (b_type == "u_iso")
-		f = get_Uiso_as_B;
-	else if (b_type == "b_aniso") {
-		f = get_Baniso_as_B;
-		iso = false;
-	}
-	else if (b_type == "u_aniso") {
-		f = get_Uaniso_as_B;
-		iso = false;
+	const std::shared_ptr<const void>& storage{ column.getStorage() };
+	if (!column.isView() || !storage) {
+		return false;
 	}
-	else if (b_type == "be_aniso") {
-		f = get_BEaniso_as_B;
-		iso = false;
+	if (std::find(m_storage.cbegin(), m_storage.cend(), storage) == m_storage.cend()) {
+		m_storage.push_back(storage);
 	}
+	return true;
+}
 
-	std::unordered_map<std::string, std::string> dict{};
-	std::optional<std::vector<std::string>> b_values{ f(block) };
-
-	//need to be a bunch of checks to ensure that I return an empty dict in the case that it shouuld be.
-	bool all_good{ true };
-
-	all_good = all_good && b_values.has_value();
-	all_good = all_good && (iso ? block.contains("_atom_site_label") : block.contains("_atom_site_aniso_label"));
-
-	if (!all_good)
-		return dict;
-
-	std::vector<std::string> b_labels = iso ? block.getValue("_atom_site_label").getStrings() : block.getValue("_atom_site_aniso_label").getStrings();
-
-	all_good = all_good && (b_values.value().size() == b_labels.size());
-
-	if (!all_good)
-		return dict;
-
-	dict.reserve(b_labels.size());
-	std::transform(b_labels.cbegin(), b_labels.cend(), b_values.value().begin(), std::inserter(dict, dict.end()),
-		[](const std::string& k, const std::string& v) {  return std::make_pair(k, v); });
-
-	static const std::array bad_vals{ "nan", "0.000", ".", "?" };
-	std::erase_if(dict, [](const auto& kv) { auto const& [_, val] = kv; return contains(bad_vals, val); });
-
-	return dict;
+std::string_view Sites::hold(const std::string_view v, bool kept)
+{
+	return kept ? v : m_text.store(v);
 }
 
-std::vector<std::string> Sites::get_atoms(const row::cif::Block& block)
+void Sites::read_coords(const row::cif::Datavalue& column, std::span<const std::string_view> labels, std::string_view Site::* coord)
 {
-	auto initialiser = [&] {
-		if (block.contains("_atom_site_type_symbol")) {
-			return fix_atom_types(block.getValue("_atom_site_type_symbol").getStrings());
+	const std::span<const std::string_view> coords{ column.getViews() };
+	const bool kept{ keep(column) };
+	for (size_t i{ 0 }; i < m_sites.size(); ++i) {
+		if (std::optional<std::string> fraction{ fraction_for(coords[i], labels[i]) }) {
+			m_sites[i].*coord = m_text.store(*fraction);
 		}
-		logger.log(Logger::Verbosity::SOME, "Atom types inferred from site labels. Please check for correctness.");
-		return labels_to_atoms(block.getValue("_atom_site_label").getStrings());
-	};
-
-	std::vector<std::string> atoms{ initialiser() };
-	return pad_column_i(atoms);
+		else {
+			m_sites[i].*coord = hold(coords[i].substr(0, coords[i].find('(')), kept);
+		}
+	}
 }
 
-std::vector<std::string> Sites::get_occs(const row::cif::Block& block)
+void Sites::read_atoms(const row::cif::Block& block, std::span<const std::string_view> labels, bool keep_labels)
 {
-	auto initialiser = [&] {
-		if (block.contains("_atom_site_occupancy")) {
-			return block.getValue("_atom_site_occupancy").getStrings();
+	if (const row::cif::Datavalue* types{ block.find("_atom_site_type_symbol"_tag) }) {
+		const std::span<const std::string_view> atoms{ types->getViews() };
+		const bool kept{ keep(*types) };
+		for (size_t i{ 0 }; i < m_sites.size(); ++i) {
+			const std::string atom{ fix_atom_type(atoms[i]) };
+			m_sites[i].atom = atom == atoms[i] ? hold(atoms[i], kept) : m_text.store(atom);
 		}
-		logger.log(Logger::Verbosity::SOME, "No occupancies found. All set to 1.");
-		return std::vector<std::string>(block.getValue("_atom_site_label").size(), std::string{ "1." });
-	};
+		return;
+	}
 
-	std::vector<std::string> occs{ initialiser() };
-	return pad_column_i(strip_brackets_i(occs));
+	logger.log(Logger::Verbosity::SOME, "Atom types inferred from site labels. Please check for correctness.");
+	for (size_t i{ 0 }; i < m_sites.size(); ++i) {
+		std::string atom{ labels[i] };
+		label_to_atom_i(atom);
+		m_sites[i].atom = labels[i].starts_with(atom) ? hold(labels[i].substr(0, atom.size()), keep_labels) : m_text.store(atom);
+	}
 }
 
-std::vector<std::string> Sites::get_Beqs(const row::cif::Block& block) noexcept(false)
+void Sites::read_occs(const row::cif::Block& block)
 {
-	static const std::array<std::string, 5> beq_types{ "b_iso", "u_iso", "b_aniso", "u_aniso", "be_aniso" };
-	std::unordered_map<std::string, std::unordered_map<std::string, std::string>> all_beqs{};
-	for (const std::string& beq : beq_types) {
-		all_beqs[beq] = make_beq_dict(block, beq);
+	if (const row::cif::Datavalue* occs{ block.find("_atom_site_occupancy"_tag) }) {
+		const std::span<const std::string_view> values{ occs->getViews() };
+		const bool kept{ keep(*occs) };
+		for (size_t i{ 0 }; i < m_sites.size(); ++i) {
+			m_sites[i].occ = hold(values[i].substr(0, values[i].find('(')), kept);
+		}
+		return;
 	}
 
-	const std::vector<std::string>& labels = block.getValue("_atom_site_label").getStrings();
-	std::vector<std::string> beqs{};
-	beqs.reserve(labels.size());
+	logger.log(Logger::Verbosity::SOME, "No occupancies found. All set to 1.");
+	for (Site& site : m_sites) {
+		site.occ = "1.";
+	}
+}
 
-	for (const std::string& label : labels) {
-		bool found = false;
-		for (const std::string& beq : beq_types) {
-			auto it = all_beqs[beq].find(label);
-			if (it == all_beqs[beq].end())
-				continue;
+void Sites::read_Beqs(const row::cif::Block& block, std::span<const std::string_view> labels) noexcept(false)
+{
+	const row::util::PhaseTimer timer{ row::util::Phase::Beq };
+	const BeqResolver resolver{ block };
 
-			found = true;
-			if (beq == beq_types[1])
+	for (size_t i{ 0 }; i < m_sites.size(); ++i) {
+		const std::string_view label{ labels[i] };
+		std::optional<std::pair<std::string, BeqSource>> beq{ resolver.resolve(i) };
+		if (!beq) {
+			if (logger.enabled(Logger::Verbosity::SOME)) {
+				logger.log(Logger::Verbosity::SOME, std::format("beq value missing or zero for site {0}! Default value of '1.' entered.", label));
+			}
+			m_sites[i].beq = "1.";
+			continue;
+		}
+
+		auto& [value, source] = *beq;
+		if (logger.enabled(Logger::Verbosity::ALL)) {
+			if (source == BeqSource::U_iso)
 				logger.log(Logger::Verbosity::ALL, std::format("beq value for site {0} calculated from isotropic U value.", label));
-			else if (beq == beq_types[2])
+			else if (source == BeqSource::B_aniso)
 				logger.log(Logger::Verbosity::ALL, std::format("beq value for site {0} calculated from anisotropic B values", label));
-			else if (beq == beq_types[3])
+			else if (source == BeqSource::U_aniso)
 				logger.log(Logger::Verbosity::ALL, std::format("beq value for site {0} calculated from anisotropic U values", label));
-			else if (beq == beq_types[4])
+			else if (source == BeqSource::Beta_aniso)
 				logger.log(Logger::Verbosity::ALL, std::format("beq value for site {0} calculated from anisotropic beta values", label));
-
-			if ((it->second).starts_with('-')) {
-				logger.log(Logger::Verbosity::SOME, std::format("Negative atomic displacement parameter detected for site {0}! Please check.", label));
-			}
-			beqs.push_back(it->second);
-			break;
-		}
-		if (!found) {
-			logger.log(Logger::Verbosity::SOME, std::format("beq value missing or zero for site {0}! Default value of '1.' entered.", label));
-			beqs.emplace_back("1.");
 		}
-	}
-	return pad_column_i(beqs);
-}
 
-std::string Sites::create_string() const
-{
-	std::string s{};
-	for (const Site& site : m_sites) {
-		s += site.to_string() + '\n';
+		if (value.starts_with('-') && logger.enabled(Logger::Verbosity::SOME)) {
+			logger.log(Logger::Verbosity::SOME, std::format("Negative atomic displacement parameter detected for site {0}! Please check.", label));
+		}
+		m_sites[i].beq = m_text.store(value);
 	}
-	return s;
 }
 
 CrystalStructure::CrystalStructure(const row::cif::Block& block, std::string block_name, std::string source /*= std::string()*/, int verbosity /*= 1*/, bool add_stuff /*= true*/) 
-	: is_good{ check_block(block, verbosity) }, block_name{ std::move(block_name) }, source{ std::move(source) },
+	: block_name{ std::move(block_name) }, source{ std::move(source) }, is_good{ check_block(block, verbosity) },
 	phase_name{ make_phase_name(block) }, space_group{ make_space_group(block) }, sites{ block }, unitcell{ block },
-	m_ss{ create_string(add_stuff) }
+	add_stuff{ add_stuff }
 {
 
 }
 
-const std::string& CrystalStructure::to_string() const
+std::string CrystalStructure::to_string() const
 {
-	return m_ss;
+	return create_string(add_stuff);
+}
+
+void CrystalStructure::write_to(OutputSink& out) const
+{
+	write_to(out, add_stuff);
 }
 
 const std::string& CrystalStructure::get_source() const
@@ -632,22 +835,48 @@ const std::string& CrystalStructure::get_source() const
 
 std::string CrystalStructure::create_string(bool add_stuff, size_t indent /*= 1*/) const
 {
-	std::string tab(indent, '\t');
-	std::string tabs(indent + 1, '\t');
+	OutputSink out{};
+	write_to(out, add_stuff, indent);
+	return out.take();
+}
+
+void CrystalStructure::write_to(OutputSink& out, bool add_stuff, size_t indent /*= 1*/) const
+{
+	//everything in the str is one tab further in than the str itself
+	auto line = [&out, indent](std::string_view text) {
+		out.put('\t', indent + 1);
+		out.write(text);
+	};
 
-	std::string s{ "\tstr '" };
-	s += source + '\n';
-	s += "\t\tphase_name \"" + phase_name + "\"\n";
+	out.put('\t', indent);
+	out.print("str '{0}\n", source);
+	out.put('\t', indent + 1);
+	out.print("phase_name \"{0}\"\n", phase_name);
 	if (add_stuff) {
-		s += "\t\tPhase_Density_g_on_cm3( 0)\n";
-		s += "\t\tCS_L( ,200)\n";
-		s += "\t\tMVW(0,0,0)\n";
-		s += "\t\tscale @ 0.0001\n";
-	}
-	s += unitcell.to_string() + '\n';
-	s += "\t\tspace_group \"" + space_group + "\"\n";
-	s += sites.to_string() + '\n';
-	return s;
+		line("Phase_Density_g_on_cm3( 0)\n");
+		line("CS_L( ,200)\n");
+		line("MVW(0,0,0)\n");
+		line("scale @ 0.0001\n");
+	}
+	unitcell.write_to(out, indent + 1);
+	out.put('\n');
+	out.put('\t', indent + 1);
+	out.print("space_group \"{0}\"\n", space_group);
+	sites.write_to(out, indent + 1);
+	out.put('\n');
+}
+
+const row::cif::TagFilter& CrystalStructure::tag_filter()
+{
+	static const row::cif::TagFilter filter = [] {
+		row::cif::TagFilter f{};
+		f.addTags(must_have_tags);
+		f.addTags(phase_name_tags);
+		f.addTags(space_group_tags);
+		f.addTags(Sites::site_tags);
+		return f;
+	}();
+	return filter;
 }
 
 bool CrystalStructure::check_block(const row::cif::Block& block, int verbosity) const
@@ -665,7 +894,7 @@ std::string CrystalStructure::make_phase_name(const row::cif::Block& block) cons
 	auto initialiser = [&] {
 		auto it = std::find_if(phase_name_tags.begin(), phase_name_tags.end(), [&block](const std::string& tag){ return block.contains(tag); });
 		if (it != phase_name_tags.end()) {
-			return block.getValue(*it).getStrings()[0];
+			return std::string{ block.getValue(*it).view_at(0) };
 		}
 		return std::string{ "" };
 	};
@@ -685,7 +914,7 @@ std::string CrystalStructure::make_space_group(const row::cif::Block& block) con
 	auto initialiser = [&] {
 		auto it = std::find_if(space_group_tags.begin(), space_group_tags.end(), [&block](const std::string& tag) {return block.contains(tag); });
 		if (it != space_group_tags.end()) {
-			return block.getValue(*it).getStrings()[0];
+			return std::string{ block.getValue(*it).view_at(0) };
 		}
 		return std::string{ "" };
 	};
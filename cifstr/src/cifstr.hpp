@@ -15,6 +15,9 @@
 #include <stdexcept>
 #include <string_view>
 #include <cmath>
+#include <span>
+#include <cstdint>
+#include <iterator>
 
 #include "ctre/ctre.hpp"
 
@@ -25,7 +28,8 @@ using namespace row;
 using namespace row::util;
 
 
-static Logger logger{};
+//each thread gets its own logger, so concurrent conversions can have their own verbosity and destination.
+inline thread_local Logger logger{};
 
 static constexpr double as_B{ 8 * std::numbers::pi * std::numbers::pi };
 
@@ -70,23 +74,181 @@ static constexpr const std::array<std::string_view, 212> allowed_atoms
   "Bk",   "Cf" };
 
 
-
+//Element symbols and scattering factors as small integer codes, so checking one is a single table lookup
+// instead of a scan through the arrays above. A symbol is an upper case letter and maybe a lower case one,
+// and a scattering factor is a symbol and maybe a sign and a single digit.
+namespace atom_codes {
+    static constexpr size_t npos{ static_cast<size_t>(-1) };
+    static constexpr size_t symbol_count{ 26 * 27 };
+    static constexpr size_t charge_count{ 19 }; //-9 to +9
+
+    constexpr size_t symbol_code(const std::string_view s) {
+        if (s.empty() || s.size() > 2 || s[0] < 'A' || s[0] > 'Z') {
+            return npos;
+        }
+        if (s.size() == 1) {
+            return static_cast<size_t>(s[0] - 'A') * 27;
+        }
+        if (s[1] < 'a' || s[1] > 'z') {
+            return npos;
+        }
+        return static_cast<size_t>(s[0] - 'A') * 27 + static_cast<size_t>(s[1] - 'a') + 1;
+    }
+
+    //sign and charge are both empty for a neutral atom
+    constexpr size_t atom_code(const std::string_view symbol, const std::string_view sign, const std::string_view charge) {
+        const size_t sym{ symbol_code(symbol) };
+        if (sym == npos) {
+            return npos;
+        }
+        if (sign.empty() && charge.empty()) {
+            return sym * charge_count + 9;
+        }
+        if (sign.size() != 1 || (sign[0] != '+' && sign[0] != '-') || charge.size() != 1 || charge[0] < '1' || charge[0] > '9') {
+            return npos;
+        }
+        const int c{ charge[0] - '0' };
+        return sym * charge_count + static_cast<size_t>(sign[0] == '-' ? 9 - c : 9 + c);
+    }
+
+    //eg "Fe+3"
+    constexpr size_t atom_code(const std::string_view atom) {
+        const size_t symLen{ atom.size() > 1 && atom[1] >= 'a' && atom[1] <= 'z' ? 2u : 1u };
+        if (atom.size() <= symLen) {
+            return atom_code(atom, "", "");
+        }
+        return atom_code(atom.substr(0, symLen), atom.substr(symLen, 1), atom.substr(symLen + 1));
+    }
+
+    template<size_t Bits>
+    using Table = std::array<uint64_t, (Bits + 63) / 64>;
+
+    //every name has to have a code, or it won't compile
+    template<size_t Bits, size_t N, typename F>
+    constexpr Table<Bits> make_table(const std::array<std::string_view, N>& names, F code) {
+        Table<Bits> table{};
+        for (const std::string_view name : names) {
+            const size_t c{ code(name) };
+            if (c >= Bits) {
+                throw std::logic_error("Name can't be given a code.");
+            }
+            table[c / 64] |= uint64_t{ 1 } << (c % 64);
+        }
+        return table;
+    }
+
+    template<size_t Words>
+    constexpr bool test(const std::array<uint64_t, Words>& table, const size_t c) {
+        return c < Words * 64 && (table[c / 64] >> (c % 64) & 1) != 0;
+    }
+
+    static constexpr Table<symbol_count> element_table{
+        make_table<symbol_count>(elements, [](std::string_view s) { return symbol_code(s); }) };
+    static constexpr Table<symbol_count * charge_count> allowed_atom_table{
+        make_table<symbol_count * charge_count>(allowed_atoms, [](std::string_view s) { return atom_code(s); }) };
+}
+
+//the same as contains(elements, s), without the search
+constexpr bool is_element(const std::string_view s) {
+    return atom_codes::test(atom_codes::element_table, atom_codes::symbol_code(s));
+}
+
+//the same as contains(allowed_atoms, s), without the search
+constexpr bool is_allowed_atom(const std::string_view s) {
+    return atom_codes::test(atom_codes::allowed_atom_table, atom_codes::atom_code(s));
+}
+
+//the same as is_allowed_atom(symbol + sign + charge), without putting the string together
+constexpr bool is_allowed_atom(const std::string_view symbol, const std::string_view sign, const std::string_view charge) {
+    return atom_codes::test(atom_codes::allowed_atom_table, atom_codes::atom_code(symbol, sign, charge));
+}
+
+
+std::string fix_atom_type(const std::string_view atom);
 std::string& fix_atom_type_i(std::string& atom);
 std::vector<std::string>& fix_atom_types_i(std::vector<std::string>& atoms);
 std::vector<std::string> fix_atom_types(std::vector<std::string> atoms);
+//a whole _atom_site_type_symbol column, straight from the views
+std::vector<std::string> fix_atom_types(std::span<const std::string_view> atoms);
 
 std::string& label_to_atom_i(std::string& label);
 std::vector<std::string>& labels_to_atoms_i(std::vector<std::string>& labels);
 std::vector<std::string> labels_to_atoms(std::vector<std::string> labels);
 
-std::string& make_frac_i(std::string& coord, const std::string_view label="");
+//A coordinate like [+-][0].<lead><repeat x min_repeats or more>[one of last] is taken to be `fraction`.
+// eg .1666667 is { "1", '6', 2, "67", "1/6" }. If last is empty, the coordinate ends with the repeats.
+struct FractionPattern {
+    std::string_view lead;
+    char repeat;
+    size_t min_repeats;
+    std::string_view last;
+    std::string_view fraction;
+};
+
+//the coordinates that are replaced by default. Add to these (eg { "25", '0', 0, "", "1/4" }) and pass them in for more.
+static constexpr std::array<FractionPattern, 4> special_fractions{ {
+    { "1", '6', 2, "67", "1/6" },
+    { "",  '3', 4, "",   "1/3" },
+    { "",  '6', 3, "67", "2/3" },
+    { "8", '3', 3, "",   "5/6" },
+} };
+
+struct FractionMatch {
+    std::string_view sign; //"", "+", or "-"
+    std::string_view fraction;
+};
+
+//one pass over the coordinate, whatever the number of patterns
+std::optional<FractionMatch> classify_fraction(const std::string_view coord, std::span<const FractionPattern> patterns = special_fractions);
 
-std::vector<std::string>& make_frac_i(std::vector<std::string>& v);
-std::vector<std::string>& make_frac_i(std::vector<std::string>& coords, const std::vector<std::string>& labels);
+//what make_frac_i would replace coord with, if anything. It says so, as make_frac_i does.
+std::optional<std::string> fraction_for(const std::string_view coord, const std::string_view label = "", std::span<const FractionPattern> patterns = special_fractions);
+
+std::string& make_frac_i(std::string& coord, const std::string_view label="", std::span<const FractionPattern> patterns = special_fractions);
+
+std::vector<std::string>& make_frac_i(std::vector<std::string>& v, std::span<const FractionPattern> patterns = special_fractions);
+std::vector<std::string>& make_frac_i(std::vector<std::string>& coords, const std::vector<std::string>& labels, std::span<const FractionPattern> patterns = special_fractions);
 std::vector<std::string> make_frac(std::vector<std::string> v);
 std::vector<std::string> make_frac(std::vector<std::string> coords, const std::vector<std::string>& labels);
 
 
+//Where STR text goes. Text is formatted straight into a buffer, which is handed on to the stream whenever it
+// gets big, so the whole structure is never held twice. Without a stream, the buffer is the result; take() it.
+class OutputSink {
+public:
+    OutputSink() = default;
+    explicit OutputSink(std::ostream& os, size_t flush_at = 64 * 1024);
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    ~OutputSink();
+
+    template<typename... Args>
+    void print(std::format_string<Args...> fmt, Args&&... args) {
+        std::format_to(std::back_inserter(m_buf), fmt, std::forward<Args>(args)...);
+        flush_if_full();
+    }
+    void write(const std::string_view sv);
+    void put(const char c);
+    void put(const char c, const size_t count);
+
+    //send everything so far to the stream, if there is one
+    void flush();
+    //everything not yet flushed, leaving the sink empty
+    std::string take();
+    //everything not yet flushed, left where it is
+    std::string_view view() const;
+    //throw away everything not yet flushed, but keep the memory, so the sink can be used again
+    void clear();
+
+private:
+    std::string m_buf{};
+    std::ostream* m_os{ nullptr };
+    size_t m_flush_at{ 0 };
+
+    void flush_if_full();
+};
+
+
 struct Vec3 {
 public:
     double x;
@@ -141,6 +303,7 @@ public:
 
     const UnitCellVectors& get_unitcellvectors() const;
     std::string to_string(size_t indent = 2) const;
+    void write_to(OutputSink& out, size_t indent = 2) const;
 
 private:
     std::string a_s;
@@ -164,57 +327,134 @@ private:
 };
 
 
+//Lines up a column of values the same way pad_column_i does, but only works out how, and leaves the values alone.
+// If any value starts with '-', the others get a space in front, then everything is padded on the right to the widest.
+class ColumnWidth {
+public:
+    void add(const std::string_view s);
+    //s, padded to fit the column
+    void write(OutputSink& out, const std::string_view s) const;
+
+private:
+    bool m_any_negative{ false };
+    size_t m_max_negative{ 0 };
+    size_t m_max_other{ 0 };
+};
+
+
+struct Site;
+
+//how wide each of the columns is. The default doesn't pad at all.
+struct SiteLayout {
+    ColumnWidth label{};
+    ColumnWidth x{};
+    ColumnWidth y{};
+    ColumnWidth z{};
+    ColumnWidth atom{};
+    ColumnWidth occ{};
+    ColumnWidth beq{};
+
+    void add(const Site& site);
+};
+
+
+//Where a site's beq can come from, best first
+enum class BeqSource { B_iso, U_iso, B_aniso, U_aniso, Beta_aniso };
+
+//Works out each site's beq from the first source, in BeqSource order, that has a usable value for it.
+// A source is only converted and formatted for the sites that get as far as it, and the aniso rows are
+// matched to sites through one index of labels.
+class BeqResolver {
+public:
+    explicit BeqResolver(const row::cif::Block& block);
+
+    //the beq of the site in row `site` of the _atom_site_label loop, and where it came from
+    std::optional<std::pair<std::string, BeqSource>> resolve(const size_t site) const;
+
+private:
+    static constexpr size_t npos{ static_cast<size_t>(-1) };
+    static constexpr size_t source_count{ 5 };
+
+    //the column(s) a source reads. Empty if the block doesn't have it, or it doesn't line up with its labels.
+    std::array<std::array<const row::cif::Datavalue*, 3>, source_count> m_columns{};
+    std::vector<size_t> m_iso_row{}; //for each site, the first row with its label
+    std::vector<size_t> m_aniso_row{}; //for each site, the first aniso row with its label, or npos
+    double m_mas{ 1.0 };
+    double m_mbs{ 1.0 };
+    double m_mcs{ 1.0 };
+
+    std::string value(const BeqSource source, const size_t row) const;
+};
+
+
+//The values are views of text owned by someone else, usually the Sites it's in, or what it keeps alive.
 struct Site {
 public:
-    std::string label{};
-    std::string x{};
-    std::string y{};
-    std::string z{};
-    std::string atom{};
-    std::string occ{};
-    std::string beq{};
+    std::string_view label{};
+    std::string_view x{};
+    std::string_view y{};
+    std::string_view z{};
+    std::string_view atom{};
+    std::string_view occ{};
+    std::string_view beq{};
 
-    Site(std::string t_label, std::string t_x, std::string t_y, std::string t_z, std::string t_atom, std::string t_occ, std::string t_beq);
+    Site(std::string_view t_label, std::string_view t_x, std::string_view t_y, std::string_view t_z, std::string_view t_atom, std::string_view t_occ, std::string_view t_beq);
 
     std::string to_string(size_t indent = 2) const;
+    void write_to(OutputSink& out, const SiteLayout& layout = {}, size_t indent = 2) const;
 };
 
 
+//The sites look straight at the values of the block they came from, and keep whatever those values look
+// at (a mapped file, or an arena) alive. Only the values that are changed, and values the block owns
+// itself, are copied. A structure made from a Cif that a Parser read with ValueStorage::Arena can't
+// outlive the Parser, just as the Cif can't.
 class Sites {
 private:
+    row::cif::StringArena m_text{}; //the values that had to be copied
+    std::vector<std::shared_ptr<const void>> m_storage{}; //what the rest of the values look at
     std::vector<Site> m_sites{};
-    std::string m_ss{};
+    SiteLayout m_layout{};
 
 public:
+    //the optional tags that Sites reads. The required ones are in CrystalStructure::must_have_tags
+    static constexpr std::array site_tags{ "_atom_site_type_symbol", "_atom_site_occupancy", "_atom_site_B_iso_or_equiv", "_atom_site_U_iso_or_equiv",
+                                           "_atom_site_aniso_label", "_atom_site_aniso_B_11", "_atom_site_aniso_B_22", "_atom_site_aniso_B_33",
+                                           "_atom_site_aniso_U_11", "_atom_site_aniso_U_22", "_atom_site_aniso_U_33",
+                                           "_atom_site_aniso_beta_11", "_atom_site_aniso_beta_22", "_atom_site_aniso_beta_33" };
+
     Sites(const row::cif::Block& block);
 
-    const std::string& to_string() const;
+    std::string to_string() const;
+    //one site per line
+    void write_to(OutputSink& out, size_t indent = 2) const;
 
 private:
-    static std::optional<std::vector<std::string>> get_Biso(const row::cif::Block& block);
-    static std::optional<std::vector<std::string>> get_Uiso_as_B(const row::cif::Block& block);
-    static std::optional<std::vector<std::string>> get_Baniso_as_B(const row::cif::Block& block);
-    static std::optional<std::vector<std::string>> get_Uaniso_as_B(const row::cif::Block& block);
-    static std::optional<std::vector<std::string>> get_BEaniso_as_B(const row::cif::Block& block);
-    static std::unordered_map<std::string, std::string> make_beq_dict(const row::cif::Block& block, const std::string& b_type);
-    static std::vector<std::string> get_atoms(const row::cif::Block& block);
-    static std::vector<std::string> get_occs(const row::cif::Block& block);
-    static std::vector<std::string> get_Beqs(const row::cif::Block& block) noexcept(false);
-
-    std::string create_string() const;
+    //Each of these fills in one column of m_sites, so the messages come out a column at a time.
+    // labels are the block's own, before any "'" is replaced.
+    void read_coords(const row::cif::Datavalue& column, std::span<const std::string_view> labels, std::string_view Site::* coord);
+    void read_atoms(const row::cif::Block& block, std::span<const std::string_view> labels, bool keep_labels);
+    void read_occs(const row::cif::Block& block);
+    void read_Beqs(const row::cif::Block& block, std::span<const std::string_view> labels) noexcept(false);
+
+    //true if the views of column can be kept as they are, as what they look at is now kept alive too.
+    // If the block owns the strings, they have to be copied.
+    bool keep(const row::cif::Datavalue& column);
+    //v, if it can be kept, or a copy of it
+    std::string_view hold(const std::string_view v, bool kept);
 };
 
 
 class CrystalStructure {
 private:
-    bool is_good{ false };
     std::string block_name{};
     std::string source{};
+    bool is_good{ false }; //must come after block_name, as check_block uses it
     std::string phase_name{};
     std::string space_group{};
     Sites sites;
     UnitCell unitcell;
-    std::string m_ss{};
+    bool add_stuff{ true };
 
     static constexpr std::array phase_name_tags{ "_pd_phase_name", "_chemical_name_mineral", "_chemical_name_common", "_chemical_name_systematic", "_chemical_name_structure_type" };
     static constexpr std::array space_group_tags{ "_symmetry_space_group_name_H-M", "_space_group_name_H-M_alt", "_symmetry_Int_Tables_number", "_space_group_IT_number" };
@@ -226,9 +466,15 @@ private:
 public:
     CrystalStructure(const row::cif::Block& block, std::string block_name, std::string source = std::string(), int verbosity = 1, bool add_stuff = true);
 
-    const std::string& to_string() const;
+    //the STR text is made when it's asked for, so it can go straight to its destination
+    std::string to_string() const;
+    void write_to(OutputSink& out) const;
     const std::string& get_source() const;
     std::string create_string(bool add_stuff, size_t indent = 1) const;
+    void write_to(OutputSink& out, bool add_stuff, size_t indent = 1) const;
+
+    //all the tags that are read to make a CrystalStructure. Give it to the parser to skip everything else.
+    static const row::cif::TagFilter& tag_filter();
 
 
 private:
@@ -0,0 +1,300 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <streambuf>
+
+#if !defined(_WIN32)
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+#include "row/pdqciflib.hpp"
+
+
+
+std::optional<ServeRequest> read_request(std::istream& in, std::string& line)
+{
+	do {
+		if (!std::getline(in, line)) {
+			return std::nullopt;
+		}
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+	} while (line.empty());
+
+	std::string_view rest{ line };
+	auto next_word = [&rest] {
+		const size_t start{ std::min(rest.find_first_not_of(' '), rest.size()) };
+		const size_t end{ std::min(rest.find(' ', start), rest.size()) };
+		std::string_view word{ rest.substr(start, end - start) };
+		rest.remove_prefix(std::min(end + 1, rest.size()));
+		return word;
+	};
+
+	ServeRequest request{};
+	const std::string_view kind{ next_word() };
+	if (kind == "QUIT") {
+		return request;
+	}
+	if (kind != "PATH" && kind != "TEXT") {
+		throw std::invalid_argument(std::format("Unknown request '{0}'.", kind));
+	}
+	request.kind = kind == "PATH" ? ServeRequest::Kind::Path : ServeRequest::Kind::Text;
+
+	const std::string_view flags{ next_word() };
+	if (flags.empty() || (flags != "-" && flags.find_first_not_of("sa") != std::string_view::npos)) {
+		throw std::invalid_argument(std::format("Unknown flags '{0}'.", flags));
+	}
+	request.add_stuff = flags.find('s') != std::string_view::npos;
+	request.do_all_blocks = flags.find('a') != std::string_view::npos;
+
+	if (request.kind == ServeRequest::Kind::Text) {
+		const std::string_view length{ next_word() };
+		auto [ptr, ec] = std::from_chars(length.data(), length.data() + length.size(), request.length);
+		if (ec != std::errc{} || ptr != length.data() + length.size()) {
+			throw std::invalid_argument(std::format("TEXT needs the number of bytes, not '{0}'.", length));
+		}
+		if (request.length > max_text_bytes) {
+			throw std::invalid_argument(std::format("TEXT can't be more than {0} bytes, not {1}.", max_text_bytes, request.length));
+		}
+		request.path = rest.empty() ? "string" : std::string{ rest };
+	}
+	else {
+		if (rest.empty()) {
+			throw std::invalid_argument("PATH needs a file.");
+		}
+		request.path = rest;
+	}
+	return request;
+}
+
+
+void RequestHandler::serve(std::istream& in, std::ostream& out)
+{
+	auto reply = [&out](std::string_view status, std::string_view body) {
+		out << status << ' ' << body.size() << '\n';
+		out.write(body.data(), static_cast<std::streamsize>(body.size()));
+		out.flush();
+	};
+
+	while (true) {
+		std::optional<ServeRequest> request{};
+		try {
+			request = read_request(in, m_line);
+		}
+		catch (const std::invalid_argument& e) {
+			reply("ERROR", e.what()); //there's no telling where the next request starts
+			return;
+		}
+		if (!request || request->kind == ServeRequest::Kind::Quit) {
+			return;
+		}
+
+		if (request->kind == ServeRequest::Kind::Text) {
+			try {
+				m_text.resize(request->length);
+			}
+			catch (const std::exception& e) {
+				reply("ERROR", std::format("No room for {0} bytes of CIF: {1}", request->length, e.what())); //and the CIF is still to come
+				return;
+			}
+			if (!in.read(m_text.data(), static_cast<std::streamsize>(request->length))) {
+				reply("ERROR", std::format("Only got {0} of the {1} bytes of CIF.", in.gcount(), request->length));
+				return;
+			}
+		}
+
+		try {
+			convert(*request);
+			reply("OK", m_sink.view());
+		}
+		catch (const std::exception& e) {
+			reply("ERROR", e.what());
+		}
+	}
+}
+
+void RequestHandler::convert(const ServeRequest& request)
+{
+	m_sink.clear();
+	m_err.str("");
+
+	row::cif::ParseOptions options{};
+	options.tags = &CrystalStructure::tag_filter();
+	options.values = row::cif::ValueStorage::Arena; //in m_parser's memory, which the Cif is finished with before the next request
+	if (!request.do_all_blocks) {
+		options.blocks = row::cif::BlockSelection::Last;
+	}
+
+	std::optional<row::cif::Cif> cif{};
+	try {
+		cif = request.kind == ServeRequest::Kind::Text
+			? m_parser.read_string(m_text, false, true, request.path, m_err, options)
+			: m_parser.read_file_mapped(request.path, false, true, m_err, options);
+	}
+	catch (const std::exception& e) {
+		throw std::runtime_error(m_err.str() + e.what());
+	}
+
+	size_t converted{ 0 };
+	auto convert_block = [&](const std::string& name, const row::cif::Block& block) {
+		try {
+			CrystalStructure(block, name, cif->getSource(), 0, request.add_stuff).write_to(m_sink);
+			m_sink.put('\n');
+			++converted;
+		}
+		catch (const std::exception& e) {
+			m_err << e.what() << '\n';
+		}
+	};
+	if (request.do_all_blocks) {
+		for (const auto& [name, block] : *cif) {
+			convert_block(name, block);
+		}
+	}
+	else if (cif->size() > 0) {
+		convert_block(cif->getLastBlockName(), cif->getLastBlock());
+	}
+
+	if (converted == 0) {
+		m_sink.clear();
+		throw std::runtime_error(m_err.str().empty() ? std::string{ "No blocks found." } : m_err.str());
+	}
+}
+
+
+void serve_stdio()
+{
+	std::ios::sync_with_stdio(false);
+	RequestHandler handler{};
+	handler.serve(std::cin, std::cout);
+}
+
+
+#if defined(_WIN32)
+
+std::string serve_socket(const std::string&, size_t)
+{
+	return "Serving on a socket is only available on Linux and macOS. Leave out the socket to use stdin and stdout.";
+}
+
+#else
+
+namespace {
+
+	//so a socket can be read and written as an iostream, like stdin and stdout are
+	class SocketBuf : public std::streambuf {
+	private:
+		int m_fd;
+		std::array<char, 64 * 1024> m_in{};
+		std::array<char, 64 * 1024> m_out{};
+
+	public:
+		explicit SocketBuf(int fd) : m_fd{ fd } {
+			setg(m_in.data(), m_in.data(), m_in.data());
+			setp(m_out.data(), m_out.data() + m_out.size());
+		}
+
+		~SocketBuf() override {
+			sync();
+			::close(m_fd);
+		}
+
+	protected:
+		int_type underflow() override {
+			const ssize_t n{ ::read(m_fd, m_in.data(), m_in.size()) };
+			if (n <= 0) {
+				return traits_type::eof();
+			}
+			setg(m_in.data(), m_in.data(), m_in.data() + n);
+			return traits_type::to_int_type(*gptr());
+		}
+
+		int_type overflow(int_type c) override {
+			if (sync() != 0) {
+				return traits_type::eof();
+			}
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+			return traits_type::not_eof(c);
+		}
+
+		int sync() override {
+			const char* p{ pbase() };
+			while (p < pptr()) {
+				const ssize_t n{ ::write(m_fd, p, static_cast<size_t>(pptr() - p)) };
+				if (n <= 0) {
+					return -1;
+				}
+				p += n;
+			}
+			setp(m_out.data(), m_out.data() + m_out.size());
+			return 0;
+		}
+	};
+
+}
+
+std::string serve_socket(const std::string& path, size_t jobs)
+{
+	sockaddr_un address{};
+	if (path.size() >= sizeof(address.sun_path)) {
+		return std::format("The socket path {0} is too long.", path);
+	}
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+	const int listener{ ::socket(AF_UNIX, SOCK_STREAM, 0) };
+	if (listener < 0) {
+		return std::format("Couldn't make a socket: {0}", std::strerror(errno));
+	}
+	struct stat existing{};
+	if (::lstat(path.c_str(), &existing) == 0) {
+		if (!S_ISSOCK(existing.st_mode)) {
+			const std::string message{ std::format("{0} is already there, and isn't a socket.", path) };
+			::close(listener);
+			return message;
+		}
+		::unlink(path.c_str()); //left over from last time
+	}
+	if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0) {
+		const std::string message{ std::format("Couldn't listen on {0}: {1}", path, std::strerror(errno)) };
+		::close(listener);
+		return message;
+	}
+	std::signal(SIGPIPE, SIG_IGN); //a client going away shouldn't take the server with it
+
+	//each worker keeps its handler, so its buffers are reused by every client it serves
+	row::util::ThreadPool pool{ jobs };
+	while (true) {
+		const int client{ ::accept(listener, nullptr, nullptr) };
+		if (client < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			const std::string message{ std::format("Stopped accepting connections: {0}", std::strerror(errno)) };
+			::close(listener);
+			return message;
+		}
+		pool.submit([client] {
+			thread_local RequestHandler handler{};
+			SocketBuf buf{ client };
+			std::iostream stream{ &buf };
+			handler.serve(stream, stream);
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef ROW_CIFSTR_SERVER_HPP
+#define ROW_CIFSTR_SERVER_HPP
+
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "cifstr.hpp"
+
+
+//cifstr --serve keeps converting CIFs until its input ends, so the start-up is only paid once.
+//
+// Requests are one line, and, for TEXT, the CIF itself straight after it:
+//   PATH <flags> <path to a CIF>
+//   TEXT <flags> <number of bytes> [<name to use as the source>]
+//   QUIT
+// where <flags> is '-', or any of 's' and 'a', which mean the same as -s and -a.
+//
+// Each is answered, in order, with a line and that many bytes:
+//   OK <number of bytes of STR text>
+//   ERROR <number of bytes of message>
+// Blank lines are ignored. A malformed request gets an ERROR, and the connection is closed. So does a TEXT
+// of more than max_text_bytes.
+
+
+inline constexpr size_t max_text_bytes{ 1024 * 1024 * 1024 };
+
+struct ServeRequest {
+    enum class Kind { Path, Text, Quit };
+    Kind kind{ Kind::Quit };
+    bool add_stuff{ false };
+    bool do_all_blocks{ false };
+    std::string path{}; //or the source name, for TEXT
+    size_t length{ 0 }; //of the CIF that follows a TEXT
+};
+
+//reads and parses one request line. nullopt at the end of the input. Throws std::invalid_argument if it's malformed.
+std::optional<ServeRequest> read_request(std::istream& in, std::string& line);
+
+
+//Answers requests from one client. Everything it allocates is kept from one request to the next.
+class RequestHandler {
+private:
+    std::string m_line{};
+    std::string m_text{};
+    std::ostringstream m_err{};
+    OutputSink m_sink{};
+    row::cif::Parser m_parser{};
+
+public:
+    //until QUIT, the end of in, or a request it can't make sense of
+    void serve(std::istream& in, std::ostream& out);
+
+private:
+    //the STR text goes into m_sink. Throws std::runtime_error with the message to send back if nothing could be converted.
+    void convert(const ServeRequest& request);
+};
+
+
+//requests come in on stdin, and the replies go to stdout
+void serve_stdio();
+
+//Each connection to the Unix domain socket at path is a client, served by one of jobs threads.
+// A socket left at path is replaced, but anything else there is left alone, and the server doesn't start.
+// Only returns if the socket can't be set up, with what went wrong.
+std::string serve_socket(const std::string& path, size_t jobs);
+
+#endif